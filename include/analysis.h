@@ -0,0 +1,102 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Analysis of a render while it is normalised, so the output is only read once:
+   integrated loudness (ITU-R BS.1770-4 / EBU R128, K-weighted and gated), true peak
+   from 4x oversampling, RMS and the energy in octave bands.  Everything is measured
+   on the samples as given; a gain applied afterwards is passed to the report.
+*/
+
+#ifndef _TRILLIAN_ANALYSIS_H_
+#define _TRILLIAN_ANALYSIS_H_
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+#define TR_ANALYSIS_BANDS      10   /* octaves centred on 31.25Hz to 16kHz */
+#define TR_ANALYSIS_OVERSAMPLE  4
+#define TR_ANALYSIS_TAPS       12   /* per phase of the true peak interpolator */
+
+typedef struct tr_biquad
+{
+	double b0, b1, b2, a1, a2;
+} tr_biquad;
+
+typedef struct tr_analysis
+{
+	unsigned int  channels;
+	unsigned int  samplerate;
+	unsigned long long frames;
+	
+	/* Loudness, the weighted K-weighted power of 100ms steps makes overlapping 400ms blocks */
+	tr_biquad     shelf;
+	tr_biquad     highpass;
+	double*       kstate;       /* 4 per channel */
+	double*       weights;      /* per channel */
+	unsigned int  step;         /* frames in 100ms */
+	unsigned int  stepfill;
+	double        steppower;
+	double        recent[4];    /* power of the last four steps */
+	unsigned int  steps;
+	double*       blocks;       /* mean power of each 400ms block */
+	unsigned int  blockcount;
+	unsigned int  blockcapacity;
+	
+	/* Peaks and RMS, per channel */
+	double*       square;
+	float*        samplepeak;
+	float*        truepeak;
+	float         phases[TR_ANALYSIS_OVERSAMPLE][TR_ANALYSIS_TAPS];
+	float*        history;      /* 2 * taps per channel, each sample stored twice */
+	unsigned int  historypos;
+	
+	/* Octave bands */
+	unsigned int  bands;        /* those below Nyquist */
+	tr_biquad     band[TR_ANALYSIS_BANDS];
+	double*       bandstate;    /* 2 per channel per band */
+	double        bandenergy[TR_ANALYSIS_BANDS];
+} tr_analysis;
+
+extern int  tr_analysis_init(tr_analysis* pAnalysis, unsigned int pChannels, unsigned int pSampleRate);
+extern void tr_analysis_free(tr_analysis* pAnalysis);
+
+/* pFrames interleaved frames, call in order over the whole signal */
+extern void tr_analysis_process(tr_analysis* pAnalysis, const float* pInput, unsigned int pFrames);
+
+/* Gated integrated loudness in LUFS, -HUGE_VAL when nothing passes the gates */
+extern double tr_analysis_loudness(const tr_analysis* pAnalysis);
+
+/* Largest true peak of any channel as a linear level, never below the sample peak */
+extern double tr_analysis_truepeak(const tr_analysis* pAnalysis);
+
+/* Results as JSON, as they will be after pGain is applied.  pTarget is the loudness the gain
+   was aimed at, -HUGE_VAL when it normalises to the peak; pLimit is the largest gain the true
+   peak allowed for that target, 0 when no limit applied. */
+extern void tr_analysis_json(const tr_analysis* pAnalysis, FILE* pFile, const char* pName, double pGain, double pTarget, double pLimit);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_ANALYSIS_H_
\ No newline at end of file
@@ -0,0 +1,68 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Response automation.
+   
+   An automation file lists when the response changes, one event per line:
+   
+       # seconds  response
+       12.5       hall.wav
+       40         corridor.wav
+   
+   All responses are pulled from the same convolver, so the input is transformed
+   once and a switch only costs a second spectral multiply while the outputs of the
+   old and new response are crossfaded.
+*/
+
+#ifndef _TRILLIAN_AUTOMATION_H_
+#define _TRILLIAN_AUTOMATION_H_
+
+#include "convolver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+typedef struct tr_automation_event
+{
+	unsigned int frame;     /* where the crossfade to this response starts */
+	char*        filename;
+} tr_automation_event;
+
+typedef struct tr_automation
+{
+	unsigned int         count;
+	tr_automation_event* events;
+} tr_automation;
+
+/* Read pFilename, pInitial is the response in use from the start */
+extern int  tr_automation_load(tr_automation* pAuto, const char* pFilename, const char* pInitial, unsigned int pSampleRate);
+extern void tr_automation_free(tr_automation* pAuto);
+
+/* Convolve a single channel, pResponses holds the response of each event */
+extern void tr_automation_render(const tr_automation* pAuto, const tr_irspectra** pResponses, tr_convolver* pConv,
+                                 const float* pInput, unsigned int pInLen, float* pOutput, unsigned int pOutLen, unsigned int pFade);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_AUTOMATION_H_
\ No newline at end of file
@@ -0,0 +1,108 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Channel batched partitioned convolution.
+   
+   Several channels run through one transform, laid out lane interleaved: every
+   sample, and every real or imaginary part of a bin, is followed by the same value
+   of the other channels.
+   
+       samples : x0[0] x1[0] .. xL-1[0]  x0[1] x1[1] ..
+       spectra : re[k] of each lane for k = 0..size/2, then im[k] of each lane
+   
+   Every pass of the transform does the same arithmetic with the same twiddles for
+   each channel, so the innermost loops run over lanes and vectorise with no shuffles.
+*/
+
+#ifndef _TRILLIAN_BATCH_H_
+#define _TRILLIAN_BATCH_H_
+
+#include "fft.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+#define TR_BATCH_MIN_LANES       4
+#define TR_BATCH_MAX_LANES       16
+#define TR_BATCH_MAX_PARTITIONS  64    /* past this the multiply-accumulate, which batching does not speed up, dominates */
+#define TR_BATCH_MAX_BLOCK       8192
+
+typedef struct tr_batch_fft
+{
+	tr_fft       tables;   /* bit reversal, twiddles and split factors shared by every lane */
+	unsigned int lanes;
+	float*       work;     /* size/2 complex per lane */
+} tr_batch_fft;
+
+typedef struct tr_batch_spectra
+{
+	unsigned int blocksize;
+	unsigned int partitions;
+	unsigned int lanes;
+	float*       spectra;  /* partitions lane interleaved split spectra of 2*blocksize point transforms */
+} tr_batch_spectra;
+
+typedef struct tr_batch_convolver
+{
+	tr_batch_fft fft;
+	unsigned int blocksize;
+	unsigned int partitions;  /* depth of the input delay line */
+	unsigned int current;     /* delay line slot of the newest input block */
+	unsigned int lanes;
+	float*       input;       /* last two input blocks */
+	float*       delayline;   /* partitions input spectra */
+	float*       accum;       /* spectrum accumulator */
+	float*       output;      /* inverse transform */
+} tr_batch_convolver;
+
+/* Lanes for a batch out of pChannels, 16, 8 or 4, 0 if fewer than 4 are left */
+extern unsigned int tr_batch_lanes(unsigned int pChannels);
+
+/* Block size for batches convolving a response of pLength samples, pBlockSize or bigger so
+   there are no more than TR_BATCH_MAX_PARTITIONS.  0 if the response is too long to batch. */
+extern unsigned int tr_batch_blocksize(unsigned int pBlockSize, unsigned int pLength);
+
+extern int  tr_batch_fft_init(tr_batch_fft* pFFT, unsigned int pSize, unsigned int pLanes);
+extern void tr_batch_fft_free(tr_batch_fft* pFFT);
+
+/* pSize lane interleaved samples to a lane interleaved split spectrum, and back */
+extern void tr_batch_fft_forward(tr_batch_fft* pFFT, const float* pInput, float* pSpectrum);
+extern void tr_batch_fft_inverse(tr_batch_fft* pFFT, const float* pSpectrum, float* pOutput);
+
+extern int  tr_batch_convolver_init(tr_batch_convolver* pConv, unsigned int pBlockSize, unsigned int pPartitions, unsigned int pLanes);
+extern void tr_batch_convolver_free(tr_batch_convolver* pConv);
+
+/* Transform one lane interleaved block of input into the delay line */
+extern void tr_batch_convolver_push(tr_batch_convolver* pConv, const float* pInput);
+/* One lane interleaved block of output, each lane convolved with its own response */
+extern void tr_batch_convolver_pull(tr_batch_convolver* pConv, const tr_batch_spectra* pResponse, float* pOutput);
+
+/* Partition and transform channels pFirst.. of an interleaved response of pChannels */
+extern int  tr_batch_spectra_init(tr_batch_spectra* pSpectra, tr_batch_fft* pFFT, const float* pResponse, unsigned int pChannels,
+                                  unsigned int pFirst, unsigned int pLength);
+extern void tr_batch_spectra_free(tr_batch_spectra* pSpectra);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_BATCH_H_
\ No newline at end of file
@@ -0,0 +1,76 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Checkpoints of a streamed render.  The render runs in two phases, convolving into
+   a raw float file while tracking the peak, then normalising that file into the wav.
+   A checkpoint records which phase, how far it got and the state of the convolvers,
+   along with the render it belongs to so a resume with other files is refused.
+   Checkpoints are written in host byte order and are not portable between machines.
+*/
+
+#ifndef _TRILLIAN_CHECKPOINT_H_
+#define _TRILLIAN_CHECKPOINT_H_
+
+#include "stream.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+#define TR_CHECKPOINT_CONVOLVE  1  /* convolving into the raw file */
+#define TR_CHECKPOINT_WRITE     2  /* normalising the raw file into the wav */
+
+typedef struct tr_checkpoint
+{
+	/* The render */
+	uint32_t channels;
+	uint32_t samplerate;
+	uint32_t inputframes;
+	uint32_t responseframes;
+	uint32_t blocksize;
+	uint32_t radix;
+	int32_t  precision;
+	int32_t  doubleaccum;
+	uint64_t input;     /* FNV-1a of the input and response samples */
+	uint64_t response;
+	
+	/* Progress */
+	uint32_t phase;
+	uint32_t frames;   /* frames finished in this phase */
+	float    peak;     /* of the frames convolved so far */
+} tr_checkpoint;
+
+/* Replaces pFilename in one step, an interrupted save leaves the previous checkpoint */
+extern int tr_checkpoint_save(const char* pFilename, const tr_checkpoint* pCheckpoint, const tr_stream* pStream);
+
+/* pStream may be NULL to read just the header, to learn the block size before making the stream */
+extern int tr_checkpoint_load(const char* pFilename, tr_checkpoint* pCheckpoint, tr_stream* pStream);
+
+/* Same render, everything but the progress matches */
+extern int tr_checkpoint_matches(const tr_checkpoint* pA, const tr_checkpoint* pB);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_CHECKPOINT_H_
\ No newline at end of file
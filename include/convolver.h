@@ -0,0 +1,96 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Uniformly partitioned overlap-save convolution.
+   
+   The input side (a delay line of input spectra) is kept apart from the response
+   side (a set of partition spectra), so one convolver can be pulled against several
+   responses while each input block is only transformed once.
+*/
+
+#ifndef _TRILLIAN_CONVOLVER_H_
+#define _TRILLIAN_CONVOLVER_H_
+
+#include "fft.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* Storage of response spectra, the multiply-accumulate is always done in float */
+#define TR_IRSPECTRA_FLOAT     0
+#define TR_IRSPECTRA_HALF      1  /* IEEE binary16, scaled per partition to stay in range */
+#define TR_IRSPECTRA_BFLOAT16  2  /* top half of a float */
+
+typedef struct tr_irspectra
+{
+	unsigned int blocksize;
+	unsigned int partitions;
+	unsigned int length;      /* samples in the response */
+	int          precision;   /* TR_IRSPECTRA_* */
+	void*        spectra;     /* partitions split spectra of 2*blocksize point transforms */
+	float*       scale;       /* per partition, applied when the spectra are read back */
+} tr_irspectra;
+
+typedef struct tr_convolver
+{
+	tr_fft       fft;
+	unsigned int blocksize;
+	unsigned int partitions;  /* depth of the input delay line */
+	unsigned int current;     /* delay line slot of the newest input block */
+	float*       input;       /* last two input blocks */
+	float*       delayline;   /* partitions input spectra */
+	float*       accum;       /* spectrum accumulator */
+	double*      accumdouble; /* spectrum accumulator for doubleaccum */
+	float*       unpacked;    /* one response partition widened to float */
+	float*       output;      /* inverse transform */
+	int          doubleaccum; /* sum the partitions in double, rounding once before the inverse transform */
+} tr_convolver;
+
+/* Pick a block size for a response of pLength samples */
+extern unsigned int tr_convolver_blocksize(unsigned int pLength);
+
+extern int  tr_convolver_init(tr_convolver* pConv, unsigned int pBlockSize, unsigned int pPartitions);
+extern void tr_convolver_free(tr_convolver* pConv);
+extern void tr_convolver_reset(tr_convolver* pConv);
+
+/* Transform one block of input into the delay line */
+extern void tr_convolver_push(tr_convolver* pConv, const float* pInput);
+/* One block of output for the input pushed so far, convolved with pResponse */
+extern void tr_convolver_pull(tr_convolver* pConv, const tr_irspectra* pResponse, float* pOutput);
+
+/* Input history and delay line, enough to carry on exactly where the convolver left off.
+   Loading needs a convolver initialised with the same block size and partitions. */
+extern int  tr_convolver_save(const tr_convolver* pConv, FILE* pFile);
+extern int  tr_convolver_load(tr_convolver* pConv, FILE* pFile);
+
+/* Partition and transform a response for convolvers using pFFT, a 2*blocksize point transform */
+extern int  tr_irspectra_init(tr_irspectra* pSpectra, tr_fft* pFFT, const float* pResponse, unsigned int pLength, int pPrecision);
+extern void tr_irspectra_free(tr_irspectra* pSpectra);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_CONVOLVER_H_
\ No newline at end of file
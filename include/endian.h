@@ -22,43 +22,70 @@
 #ifndef _ENDIAN_H_
 #define _ENDIAN_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif //__cplusplus
 
-#define BIG_ENDIAN     1
-#define LITTLE_ENDIAN  0
-
-extern const int testEndian;
-#define IS_BIG_ENDIAN()      ( (*(char*)&testEndian) == 0 )
-#define IS_LITTLE_ENDIAN()   ( (*(char*)&testEndian) != 0 )
-
-void InitEndian();
-
-extern unsigned short (*BigUShort)    ( unsigned short pVar );  //unsigned
-extern unsigned short (*LittleUShort) ( unsigned short pVar );
-extern unsigned long  (*BigULong)     ( unsigned long  pVar );
-extern unsigned long  (*LittleULong)  ( unsigned long  pVar );
-extern short  (*BigShort)     ( short pVar  );  //signed
-extern short  (*LittleShort)  ( short pVar  );
-extern long   (*BigLong)      ( long   pVar );
-extern long   (*LittleLong)   ( long   pVar );
-extern float  (*BigFloat)     ( float pVar  );
-extern float  (*LittleFloat)  ( float pVar  );
-
-unsigned long  FLIP_ULONG(unsigned long pVar); //unsigned
-unsigned short FLIP_USHORT(unsigned short pVar);
-long           FLIP_LONG(long pVar);  //signed
-short          FLIP_SHORT(short pVar);
-float          FLIP_FLOAT(float pVar);
-
-unsigned long  NO_FLIP_ULONG(unsigned long pVar);
-unsigned short NO_FLIP_USHORT(unsigned short pVar);
-long           NO_FLIP_LONG(long pVar);
-short          NO_FLIP_SHORT(short pVar);
-float          NO_FLIP_FLOAT(float pVar);
-
-void* FlipEndian(void* pAddr, const int pNb); 
+/* Host byte order, known at compile time */
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+	#define TR_HOST_BIG_ENDIAN  (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#elif defined(_WIN32) || defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64) || defined(__ARMEL__)
+	#define TR_HOST_BIG_ENDIAN  0
+#elif defined(__BIG_ENDIAN__) || defined(__ARMEB__) || defined(__sparc__) || defined(__ppc__)
+	#define TR_HOST_BIG_ENDIAN  1
+#else
+	#error "Unknown host byte order"
+#endif
+
+static inline uint16_t tr_swap16(uint16_t pVar)
+{
+	return (uint16_t)((pVar >> 8) | (pVar << 8));
+}
+
+static inline uint32_t tr_swap32(uint32_t pVar)
+{
+#if defined(__GNUC__)
+	return __builtin_bswap32(pVar);
+#else
+	return (pVar >> 24) | ((pVar >> 8) & 0x0000ff00) | ((pVar << 8) & 0x00ff0000) | (pVar << 24);
+#endif
+}
+
+static inline float tr_swapfloat(float pVar)
+{
+	union { float f; uint32_t u; } swap;
+	swap.f = pVar;
+	swap.u = tr_swap32(swap.u);
+	return swap.f;
+}
+
+#if TR_HOST_BIG_ENDIAN
+static inline uint16_t BigU16(uint16_t pVar)    { return pVar; }
+static inline uint16_t LittleU16(uint16_t pVar) { return tr_swap16(pVar); }
+static inline uint32_t BigU32(uint32_t pVar)    { return pVar; }
+static inline uint32_t LittleU32(uint32_t pVar) { return tr_swap32(pVar); }
+static inline float    BigFloat(float pVar)     { return pVar; }
+static inline float    LittleFloat(float pVar)  { return tr_swapfloat(pVar); }
+#else
+static inline uint16_t BigU16(uint16_t pVar)    { return tr_swap16(pVar); }
+static inline uint16_t LittleU16(uint16_t pVar) { return pVar; }
+static inline uint32_t BigU32(uint32_t pVar)    { return tr_swap32(pVar); }
+static inline uint32_t LittleU32(uint32_t pVar) { return pVar; }
+static inline float    BigFloat(float pVar)     { return tr_swapfloat(pVar); }
+static inline float    LittleFloat(float pVar)  { return pVar; }
+#endif
+
+static inline int16_t BigS16(int16_t pVar)    { return (int16_t)BigU16((uint16_t)pVar); }
+static inline int16_t LittleS16(int16_t pVar) { return (int16_t)LittleU16((uint16_t)pVar); }
+static inline int32_t BigS32(int32_t pVar)    { return (int32_t)BigU32((uint32_t)pVar); }
+static inline int32_t LittleS32(int32_t pVar) { return (int32_t)LittleU32((uint32_t)pVar); }
+
+/* Swap whole arrays in place, used on sample data stored in the other byte order */
+void tr_swap16_buffer(void* pData, size_t pCount);
+void tr_swap32_buffer(void* pData, size_t pCount);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,61 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Real to complex FFT.
+   
+   Spectra are kept split, the real parts of bins 0..size/2 followed by the
+   imaginary parts of bins 0..size/2, so the spectral multiplies run over
+   plain float arrays.
+*/
+
+#ifndef _TRILLIAN_FFT_H_
+#define _TRILLIAN_FFT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* Number of floats in a split spectrum of a pSize point transform */
+#define TR_FFT_SPECTRUM(pSize)  ((pSize) + 2)
+
+typedef struct tr_fft
+{
+	unsigned int  size;       /* real transform size, a power of two */
+	unsigned int  radix;      /* 2, or 4 to run the passes in pairs */
+	unsigned int* bitrev;     /* bit reverse permutation of the size/2 complex transform */
+	float*        twiddle;    /* size/2 complex transform */
+	float*        split;      /* real/complex split, size/2 complex */
+	float*        work;       /* size/2 complex */
+} tr_fft;
+
+extern int  tr_fft_init(tr_fft* pFFT, unsigned int pSize);
+extern void tr_fft_free(tr_fft* pFFT);
+
+/* pSize real samples to a split spectrum */
+extern void tr_fft_forward(tr_fft* pFFT, const float* pInput, float* pSpectrum);
+/* Split spectrum to pSize real samples, scaled so inverse(forward(x)) == x */
+extern void tr_fft_inverse(tr_fft* pFFT, const float* pSpectrum, float* pOutput);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_FFT_H_
\ No newline at end of file
@@ -0,0 +1,99 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Incremental re-rendering.  Convolution is linear and time invariant, so an edit
+   to input frames [a, b) only changes output frames [a, b + response - 1).  Those
+   spans are found by hashing blocks of the old and new input, then re-convolved
+   with the convolvers warmed up on the blocks before them, which gives the same
+   output a render from the start would.
+   
+   The spans only match their neighbours when they are convolved the way the rest
+   of the output was, so each fft render leaves a plan next to its output:
+   
+       output.wav.plan : blocksize <tab> radix <tab> precision <tab> double <tab> response hash
+*/
+
+#ifndef _TRILLIAN_INCREMENTAL_H_
+#define _TRILLIAN_INCREMENTAL_H_
+
+#include "stream.h"
+#include "wavfile.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* Frames [start, end) */
+typedef struct tr_span
+{
+	unsigned int start;
+	unsigned int end;
+} tr_span;
+
+/* How an output was convolved */
+typedef struct tr_incremental_plan
+{
+	unsigned int blocksize;
+	unsigned int radix;
+	int          precision;
+	int          doubleaccum;
+	uint64_t     response;   /* tr_incremental_hash of the interleaved response */
+} tr_incremental_plan;
+
+/* Sorted, spans that touch are merged */
+typedef struct tr_spans
+{
+	unsigned int count;
+	unsigned int capacity;
+	tr_span*     spans;
+} tr_spans;
+
+extern void tr_spans_init(tr_spans* pSpans);
+extern void tr_spans_free(tr_spans* pSpans);
+extern void tr_spans_add(tr_spans* pSpans, unsigned int pStart, unsigned int pEnd);
+extern int  tr_spans_overlap(const tr_spans* pSpans, unsigned int pStart, unsigned int pEnd);
+
+/* Add the blocks of pBlockFrames that differ between two inputs of the same length to pChanged */
+extern int  tr_incremental_diff(tr_wavfile* pOld, tr_wavfile* pNew, unsigned int pBlockFrames, tr_spans* pChanged);
+
+/* Output spans touched by the changed input, widened by the response and rounded out to whole blocks */
+extern void tr_incremental_affected(const tr_spans* pChanged, unsigned int pResponseFrames, unsigned int pBlockSize,
+                                    unsigned int pTotalFrames, tr_spans* pAffected);
+
+/* Interleaved output frames [pStart, pEnd) of pInput, before normalising.  pStart is on a block boundary. */
+extern int  tr_incremental_render(tr_stream* pStream, tr_wavfile* pInput, unsigned int pInputFrames,
+                                  unsigned int pStart, unsigned int pEnd, float* pOutput);
+
+/* FNV-1a over the bits of pCount samples */
+extern uint64_t tr_incremental_hash(const float* pData, unsigned int pCount);
+
+/* The plan of pOutputName, kept in pOutputName.plan.  Load fails when there is none. */
+extern int  tr_incremental_saveplan(const char* pOutputName, const tr_incremental_plan* pPlan);
+extern int  tr_incremental_loadplan(const char* pOutputName, tr_incremental_plan* pPlan);
+extern void tr_incremental_removeplan(const char* pOutputName);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_INCREMENTAL_H_
\ No newline at end of file
@@ -0,0 +1,62 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Cache of transformed responses, keyed by filename.  A response that is used
+   several times is only read and partitioned once.
+*/
+
+#ifndef _TRILLIAN_IR_CACHE_H_
+#define _TRILLIAN_IR_CACHE_H_
+
+#include "convolver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+typedef struct tr_ircache_entry
+{
+	char*          filename;
+	unsigned int   channels;
+	unsigned int   samplerate;
+	unsigned int   frames;
+	tr_irspectra*  spectra;    /* one per channel */
+	struct tr_ircache_entry* next;
+} tr_ircache_entry;
+
+typedef struct tr_ircache
+{
+	tr_fft            fft;
+	int               precision;  /* storage of the spectra, TR_IRSPECTRA_* */
+	tr_ircache_entry* entries;
+} tr_ircache;
+
+extern int  tr_ircache_init(tr_ircache* pCache, unsigned int pBlockSize, int pPrecision);
+extern void tr_ircache_free(tr_ircache* pCache);
+
+/* Read and transform pFilename on first use, NULL if it is not a usable wav file */
+extern const tr_ircache_entry* tr_ircache_get(tr_ircache* pCache, const char* pFilename);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_IR_CACHE_H_
\ No newline at end of file
@@ -0,0 +1,64 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Multirate convolution for long responses.
+   
+   The late tail of a room response carries little high frequency energy, so it is
+   convolved at a decimated rate while the early part is convolved at the full rate.
+   
+       early : x * h_early                                    (full rate)
+       late  : up( down(LP*x) * D*down(LP*h_late) ) * D*LP    (1/D rate)
+   
+   The early and late parts are split with a raised cosine crossover so that
+   h_early + h_late == h.  LP is a linear phase anti-alias/anti-imaging filter shared
+   by the decimators and the interpolator, its delay is compensated on output.
+*/
+
+#ifndef _TRILLIAN_MULTIRATE_H_
+#define _TRILLIAN_MULTIRATE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+#define TR_MULTIRATE_MAX_FACTOR  4
+#define TR_MULTIRATE_FADE        512   /* crossover fade length in samples */
+#define TR_MULTIRATE_TAPS        64    /* filter taps per unit of decimation factor */
+
+typedef struct tr_multirate
+{
+	unsigned int factor;     /* decimation of the late part, 1 means the whole response runs at full rate */
+	unsigned int crossover;  /* first sample of the late part, the fade runs from here */
+	float        error;      /* predicted error of the late path relative to the full response, dB */
+	int          doubleaccum; /* sum both paths in double, off unless set after planning */
+} tr_multirate;
+
+/* Choose the largest decimation factor that keeps the late path error below pMaxError (dB) */
+extern void tr_multirate_plan(tr_multirate* pPlan, const float* pResponse, unsigned int pReLen, unsigned int pCrossover, float pMaxError);
+
+/* Convolve a single channel, pOutput must hold pInLen + pReLen - 1 samples */
+extern void tr_multirate_convolve(const tr_multirate* pPlan, const float* pInput, unsigned int pInLen, const float* pResponse, unsigned int pReLen, float* pOutput);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_MULTIRATE_H_
\ No newline at end of file
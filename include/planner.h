@@ -0,0 +1,58 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   FFT engine planner.
+   
+   Picks the block size and FFT radix for a response length and channel count, either
+   by estimate or by timing candidate plans on this machine.  Measured winners are
+   kept in a wisdom file keyed by CPU model, so later runs reuse them straight away.
+   
+   Wisdom file, one plan per line:
+   
+       cpu model <tab> length bucket <tab> channels <tab> blocksize <tab> radix
+*/
+
+#ifndef _TRILLIAN_PLANNER_H_
+#define _TRILLIAN_PLANNER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+#define TR_PLAN_ESTIMATE    0  /* wisdom if we have it, otherwise the block size heuristic */
+#define TR_PLAN_MEASURE     1  /* time block sizes near the heuristic */
+#define TR_PLAN_EXHAUSTIVE  2  /* time every block size, more repeats */
+
+typedef struct tr_plan
+{
+	unsigned int blocksize;
+	unsigned int radix;
+	int          measured;   /* 1 if it was timed now, 2 if it came from wisdom */
+} tr_plan;
+
+/* pWisdom may be NULL for the default file */
+extern void tr_planner_plan(tr_plan* pPlan, unsigned int pLength, unsigned int pChannels, int pMode, const char* pWisdom);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_PLANNER_H_
\ No newline at end of file
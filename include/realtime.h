@@ -0,0 +1,61 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Simulated live playback.  The stream is driven one device block at a time as an
+   audio callback would be, each block timed against the time it plays for.  Nothing
+   is allocated, locked or written to disk inside the loop, so the timings are those
+   of the convolution alone.
+*/
+
+#ifndef _TRILLIAN_REALTIME_H_
+#define _TRILLIAN_REALTIME_H_
+
+#include "stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* Tenths of the deadline up to 100%, then 100-200% and over 200% */
+#define TR_REALTIME_BINS  12
+
+typedef struct tr_realtime_stats
+{
+	unsigned int blocks;
+	unsigned int xruns;       /* blocks that took longer than they play for */
+	double       deadline;    /* seconds per block */
+	double       worst;       /* seconds */
+	unsigned int worstblock;
+	double       total;       /* seconds spent processing */
+	unsigned int histogram[TR_REALTIME_BINS];
+} tr_realtime_stats;
+
+/* Convolve pInput into pOutputFrames of pOutput in blocks of the stream's block size.
+   pScratch holds a block of interleaved frames for the ends of the input and output. */
+extern void tr_realtime_simulate(tr_stream* pStream, const float* pInput, unsigned int pInputFrames,
+                                 float* pOutput, unsigned int pOutputFrames, float* pScratch,
+                                 unsigned int pSampleRate, tr_realtime_stats* pStats);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_REALTIME_H_
\ No newline at end of file
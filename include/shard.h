@@ -0,0 +1,81 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Sharded renders.  The output is cut into N ranges on block boundaries and each
+   process renders one of them into a partial file, starting the convolvers a delay
+   line's worth of blocks early so its samples come out exactly as a single run would
+   give them.  The partials never overlap, merging normalises them to the largest of
+   their peaks and writes them out one after the other.  Each header names the input,
+   response and settings it was rendered from, a merge refuses partials that differ.
+*/
+
+#ifndef _TRILLIAN_SHARD_H_
+#define _TRILLIAN_SHARD_H_
+
+#include "stream.h"
+#include "wavfile.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+#define TR_SHARD_MAX  4096  /* most shards one render can be cut into */
+
+/* Header of a partial file, followed by the interleaved float frames of its range */
+typedef struct tr_shard
+{
+	uint32_t index;           /* 1 to count */
+	uint32_t count;
+	uint32_t channels;
+	uint32_t samplerate;
+	uint32_t bytespersample;
+	uint32_t blocksize;
+	uint32_t radix;
+	int32_t  precision;
+	int32_t  doubleaccum;
+	uint32_t totalframes;     /* of the whole render */
+	uint32_t start;           /* output frames [start, end) in this partial */
+	uint32_t end;
+	uint32_t complete;        /* set once every frame is written */
+	float    peak;
+	uint64_t input;           /* hashes of the interleaved input and response samples */
+	uint64_t response;
+} tr_shard;
+
+/* Fill in the output range of shard pIndex of pCount */
+extern void tr_shard_range(tr_shard* pShard, unsigned int pIndex, unsigned int pCount, unsigned int pTotalFrames, unsigned int pBlockSize);
+
+/* Convolve the shard's range of pInput into pFile */
+extern int  tr_shard_render(tr_shard* pShard, tr_stream* pStream, tr_wavfile* pInput, unsigned int pInputFrames, FILE* pFile);
+
+extern int  tr_shard_readheader(tr_shard* pShard, FILE* pFile);
+
+/* Check pShards are the complete set of one render, then normalise and write them in order */
+extern int  tr_shard_merge(FILE** pPartials, const tr_shard* pShards, unsigned int pCount, tr_wavfile* pOutput);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_SHARD_H_
\ No newline at end of file
@@ -0,0 +1,72 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Sparse early reflections with a partitioned tail.
+   
+   A synthesized room response is mostly zeros up to the diffuse tail, a few hundred
+   discrete reflections spread over tens of milliseconds.  Those are convolved as taps,
+   each one adding a gained and delayed copy of the input, and only the dense tail goes
+   through the partitioned convolver.
+   
+       y[n] = sum over taps k of g_k x[n - d_k]  +  (x * h_tail)[n - split]
+   
+   The split is placed where taps before it and partitions after it cost least.
+*/
+
+#ifndef _TRILLIAN_SPARSE_H_
+#define _TRILLIAN_SPARSE_H_
+
+#include "convolver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+#define TR_SPARSE_PARTITION_COST  8.0f    /* cost of one tail partition per output sample, in taps */
+#define TR_SPARSE_TRANSFORM_COST  200.0f  /* cost of the tail transforms per output sample, in taps */
+#define TR_SPARSE_CHUNK           2048  /* output samples accumulated per pass over the taps */
+
+typedef struct tr_sparse
+{
+	unsigned int  split;       /* first sample of the tail, everything before it is taps */
+	unsigned int  partitions;  /* partitions of the tail, 0 when the whole response is taps */
+	unsigned int  taps;        /* nonzero samples, or samples above the floor, before the split */
+	unsigned int* delays;      /* ascending */
+	float*        gains;
+} tr_sparse;
+
+/* Find the split between taps and tail for a convolver of pBlockSize.  pFloor is a level relative
+   to the peak, samples before the split at or under it are dropped rather than made taps; 0 drops
+   only zeros and keeps the convolution exact.  A split of 0 leaves nothing to gain over the fft
+   engine.  Returns 0 when out of memory. */
+extern int  tr_sparse_plan(tr_sparse* pPlan, const float* pResponse, unsigned int pReLen, unsigned int pBlockSize, float pFloor);
+extern void tr_sparse_free(tr_sparse* pPlan);
+
+/* Convolve a single channel, pConv must have at least pPlan->partitions partitions.
+   pOutLen samples are written to pOutput.  Returns 0 when the tail spectra can not be allocated. */
+extern int  tr_sparse_convolve(const tr_sparse* pPlan, tr_convolver* pConv, int pPrecision, const float* pInput, unsigned int pInLen,
+                               const float* pResponse, unsigned int pReLen, float* pOutput, unsigned int pOutLen);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_SPARSE_H_
\ No newline at end of file
@@ -0,0 +1,66 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Block at a time convolution of interleaved audio with the fft engine.  Each
+   channel has its own convolver and response, state can be saved between blocks
+   so a long render can stop and carry on later.
+*/
+
+#ifndef _TRILLIAN_STREAM_H_
+#define _TRILLIAN_STREAM_H_
+
+#include "convolver.h"
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+typedef struct tr_stream
+{
+	unsigned int  channels;
+	unsigned int  blocksize;
+	tr_convolver* convolvers;  /* one per channel */
+	tr_irspectra* spectra;     /* one per channel */
+	float*        block;       /* one channel of one block */
+} tr_stream;
+
+/* pResponse is interleaved, pFrames long */
+extern int  tr_stream_init(tr_stream* pStream, const float* pResponse, unsigned int pFrames, unsigned int pChannels,
+                           unsigned int pBlockSize, unsigned int pRadix, int pPrecision, int pDoubleAccum);
+extern void tr_stream_free(tr_stream* pStream);
+extern void tr_stream_reset(tr_stream* pStream);
+
+/* Convolve blocksize interleaved frames of input into as many frames of output */
+extern void tr_stream_process(tr_stream* pStream, const float* pInput, float* pOutput);
+/* Only take in a block, for warming up the delay lines ahead of the output wanted */
+extern void tr_stream_push(tr_stream* pStream, const float* pInput);
+
+/* State of every channel's convolver, the responses are not saved */
+extern int  tr_stream_save(const tr_stream* pStream, FILE* pFile);
+extern int  tr_stream_load(tr_stream* pStream, FILE* pFile);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+#endif //_TRILLIAN_STREAM_H_
\ No newline at end of file
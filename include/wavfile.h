@@ -24,6 +24,9 @@
 
 #include <stdio.h>
 
+#define TR_WAV_WRITE_BUFFER  (1 << 20)  /* bytes gathered before each write once the length is reserved */
+#define TR_WAV_ALIGN         4096       /* O_DIRECT offsets and lengths are multiples of this */
+
 #ifdef __cplusplus
 extern "C" {
 #endif //__cplusplus
@@ -37,18 +40,39 @@ typedef struct tr_wavfile
 	unsigned int       totalsamples;
 	unsigned int       samplerate;
 	unsigned int       bytespersample;
+	unsigned char      bigendian;      /* RIFX, samples and sizes are big endian */
 	
 	void (*frompcm_func) (void* pSourcePCM, void* pFloatDest, unsigned int pNumSamples);
 	unsigned int datastartpos;
+	unsigned int readpos;      /* next sample tr_wavread returns */
+	
+	/* Writer state after tr_wavreserve, the buffer holds the file from writeoffset on */
+	unsigned int   reserved;      /* samples the header was written for */
+	unsigned char* writememory;
+	unsigned char* writebuffer;   /* writememory aligned to TR_WAV_ALIGN */
+	long int       writeoffset;
+	unsigned int   writefill;     /* bytes */
+	unsigned char  direct;        /* writes bypass the page cache */
 } tr_wavfile;
 
 
 extern int  tr_wavopen(FILE* pFile, tr_wavfile* pWav, unsigned char pMode);
-extern void tr_wavclose(tr_wavfile* pWav);
+/* Returns 0 when samples still gathered, or the header of a written file, failed to reach it */
+extern int  tr_wavclose(tr_wavfile* pWav);
 
 extern int  tr_wavread(tr_wavfile* pWav, float* pBuffer, unsigned int pNumSamples);
+extern void tr_wavseek(tr_wavfile* pWav, unsigned int pSample);
 extern int  tr_wavwrite(tr_wavfile* pWav, float* pBuffer, unsigned int pNumSamples);
 
+/* Announce the final length of a file opened with 'w' once channels and sample rate are set.
+   The header is written first, the file is preallocated where the system can, and later writes
+   are gathered into large aligned writes.  pDirect asks for O_DIRECT, it is dropped quietly
+   where the system or file system does not have it. */
+extern int  tr_wavreserve(tr_wavfile* pWav, unsigned int pNumSamples, int pDirect);
+
+/* Write out anything gathered by a reserved writer */
+extern int  tr_wavflush(tr_wavfile* pWav);
+
 #ifdef __cplusplus
 }
 #endif //__cplusplus
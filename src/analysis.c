@@ -0,0 +1,399 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "analysis.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define TR_ANALYSIS_ABSOLUTE_GATE  -70.0   /* LUFS */
+#define TR_ANALYSIS_RELATIVE_GATE  -10.0   /* LU below the absolutely gated loudness */
+
+static inline double tr_biquad_run(const tr_biquad* pFilter, double* pState, double pInput);
+static double tr_analysis_db(double pPower);
+
+
+/**
+	K-weighting of BS.1770 at any rate, the 48kHz coefficients of the standard come
+	from these analog prototypes.  See:  https://github.com/jiixyj/libebur128
+*/
+static void tr_analysis_kweighting(tr_analysis* pAnalysis)
+{
+	double f0 = 1681.974450955533;
+	double G  = 3.999843853973347;
+	double Q  = 0.7071752369554196;
+	double K  = tan(M_PI * f0 / pAnalysis->samplerate);
+	double Vh = pow(10.0, G / 20.0);
+	double Vb = pow(Vh, 0.4996667741545416);
+	double a0 = 1.0 + K / Q + K * K;
+	
+	pAnalysis->shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+	pAnalysis->shelf.b1 = 2.0 * (K * K - Vh) / a0;
+	pAnalysis->shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+	pAnalysis->shelf.a1 = 2.0 * (K * K - 1.0) / a0;
+	pAnalysis->shelf.a2 = (1.0 - K / Q + K * K) / a0;
+	
+	f0 = 38.13547087602444;
+	Q  = 0.5003270373238773;
+	K  = tan(M_PI * f0 / pAnalysis->samplerate);
+	a0 = 1.0 + K / Q + K * K;
+	
+	pAnalysis->highpass.b0 = 1.0;
+	pAnalysis->highpass.b1 = -2.0;
+	pAnalysis->highpass.b2 = 1.0;
+	pAnalysis->highpass.a1 = 2.0 * (K * K - 1.0) / a0;
+	pAnalysis->highpass.a2 = (1.0 - K / Q + K * K) / a0;
+}
+
+int tr_analysis_init(tr_analysis* pAnalysis, unsigned int pChannels, unsigned int pSampleRate)
+{
+	unsigned int c, b, p, k;
+	
+	memset(pAnalysis, 0, sizeof(tr_analysis));
+	pAnalysis->channels   = pChannels;
+	pAnalysis->samplerate = pSampleRate;
+	pAnalysis->step       = pSampleRate / 10;
+	
+	tr_analysis_kweighting(pAnalysis);
+	
+	pAnalysis->kstate     = calloc(pChannels * 4, sizeof(double));
+	pAnalysis->weights    = malloc(pChannels * sizeof(double));
+	pAnalysis->square     = calloc(pChannels, sizeof(double));
+	pAnalysis->samplepeak = calloc(pChannels, sizeof(float));
+	pAnalysis->truepeak   = calloc(pChannels, sizeof(float));
+	pAnalysis->history    = calloc(pChannels * TR_ANALYSIS_TAPS * 2, sizeof(float));
+	pAnalysis->bandstate  = calloc(pChannels * TR_ANALYSIS_BANDS * 2, sizeof(double));
+	pAnalysis->blockcapacity = 1024;
+	pAnalysis->blocks     = malloc(pAnalysis->blockcapacity * sizeof(double));
+	
+	if(!pAnalysis->kstate || !pAnalysis->weights || !pAnalysis->square || !pAnalysis->samplepeak
+	   || !pAnalysis->truepeak || !pAnalysis->history || !pAnalysis->bandstate || !pAnalysis->blocks)
+	{
+		tr_analysis_free(pAnalysis);
+		memset(pAnalysis, 0, sizeof(tr_analysis));
+		return 0;
+	}
+	
+	/* 5.1 in the usual order has its LFE left out and the surrounds raised by 1.5dB */
+	for(c = 0; c < pChannels; c++)
+	{
+		pAnalysis->weights[c] = 1.0;
+		if(pChannels == 6)
+		{
+			pAnalysis->weights[c] = c == 3 ? 0.0 : c >= 4 ? 1.41 : 1.0;
+		}
+	}
+	
+	/* Polyphase Blackman windowed sinc, cut off at the original Nyquist, each phase at unity gain */
+	for(p = 0; p < TR_ANALYSIS_OVERSAMPLE; p++)
+	{
+		double sum = 0.0;
+		for(k = 0; k < TR_ANALYSIS_TAPS; k++)
+		{
+			unsigned int n = k * TR_ANALYSIS_OVERSAMPLE + p;
+			unsigned int length = TR_ANALYSIS_TAPS * TR_ANALYSIS_OVERSAMPLE;
+			double t = (n - (length - 1) / 2.0) / TR_ANALYSIS_OVERSAMPLE;
+			double sinc = sin(M_PI * t) / (M_PI * t);
+			double window = 0.42 - 0.5 * cos(2.0 * M_PI * n / (length - 1)) + 0.08 * cos(4.0 * M_PI * n / (length - 1));
+			pAnalysis->phases[p][k] = sinc * window;
+			sum += sinc * window;
+		}
+		for(k = 0; k < TR_ANALYSIS_TAPS; k++)
+		{
+			pAnalysis->phases[p][k] /= sum;
+		}
+	}
+	
+	/* Octave band-passes, RBJ with 0dB peak gain */
+	for(b = 0; b < TR_ANALYSIS_BANDS; b++)
+	{
+		double centre = 31.25 * (1u << b);
+		if(centre * M_SQRT2 >= pSampleRate / 2.0)
+		{
+			break;
+		}
+		double w0    = 2.0 * M_PI * centre / pSampleRate;
+		double alpha = sin(w0) * sinh(M_LN2 / 2.0 * w0 / sin(w0));
+		double a0    = 1.0 + alpha;
+		
+		pAnalysis->band[b].b0 = alpha / a0;
+		pAnalysis->band[b].b1 = 0.0;
+		pAnalysis->band[b].b2 = -alpha / a0;
+		pAnalysis->band[b].a1 = -2.0 * cos(w0) / a0;
+		pAnalysis->band[b].a2 = (1.0 - alpha) / a0;
+		++pAnalysis->bands;
+	}
+	
+	return pAnalysis->step > 0;
+}
+
+void tr_analysis_free(tr_analysis* pAnalysis)
+{
+	free(pAnalysis->kstate);
+	free(pAnalysis->weights);
+	free(pAnalysis->square);
+	free(pAnalysis->samplepeak);
+	free(pAnalysis->truepeak);
+	free(pAnalysis->history);
+	free(pAnalysis->bandstate);
+	free(pAnalysis->blocks);
+}
+
+void tr_analysis_process(tr_analysis* pAnalysis, const float* pInput, unsigned int pFrames)
+{
+	unsigned int channels = pAnalysis->channels;
+	unsigned int c, b, p, k;
+	
+	while(pFrames-- > 0)
+	{
+		unsigned int pos = pAnalysis->historypos;
+		
+		for(c = 0; c < channels; c++)
+		{
+			float x = *pInput++;
+			
+			/* Loudness */
+			double y = tr_biquad_run(&pAnalysis->shelf, pAnalysis->kstate + c * 4, x);
+			y = tr_biquad_run(&pAnalysis->highpass, pAnalysis->kstate + c * 4 + 2, y);
+			pAnalysis->steppower += pAnalysis->weights[c] * y * y;
+			
+			/* Sample and true peak, the history holds each sample twice so the taps are contiguous */
+			pAnalysis->square[c] += (double)x * x;
+			float magnitude = fabsf(x);
+			if(magnitude > pAnalysis->samplepeak[c])
+			{
+				pAnalysis->samplepeak[c] = magnitude;
+			}
+			
+			float* history = pAnalysis->history + c * TR_ANALYSIS_TAPS * 2;
+			history[pos] = history[pos + TR_ANALYSIS_TAPS] = x;
+			const float* window = history + pos + 1;
+			
+			for(p = 0; p < TR_ANALYSIS_OVERSAMPLE; p++)
+			{
+				float sum = 0.0f;
+				for(k = 0; k < TR_ANALYSIS_TAPS; k++)
+				{
+					sum += window[TR_ANALYSIS_TAPS - 1 - k] * pAnalysis->phases[p][k];
+				}
+				sum = fabsf(sum);
+				if(sum > pAnalysis->truepeak[c])
+				{
+					pAnalysis->truepeak[c] = sum;
+				}
+			}
+			
+			/* Bands */
+			double* state = pAnalysis->bandstate + c * TR_ANALYSIS_BANDS * 2;
+			for(b = 0; b < pAnalysis->bands; b++)
+			{
+				double band = tr_biquad_run(&pAnalysis->band[b], state + b * 2, x);
+				pAnalysis->bandenergy[b] += band * band;
+			}
+		}
+		
+		pAnalysis->historypos = pos + 1 == TR_ANALYSIS_TAPS ? 0 : pos + 1;
+		++pAnalysis->frames;
+		
+		/* Every 100ms a new 400ms block is complete */
+		if(++pAnalysis->stepfill == pAnalysis->step)
+		{
+			pAnalysis->recent[pAnalysis->steps % 4] = pAnalysis->steppower;
+			pAnalysis->steppower = 0.0;
+			pAnalysis->stepfill  = 0;
+			
+			if(++pAnalysis->steps >= 4)
+			{
+				if(pAnalysis->blockcount == pAnalysis->blockcapacity)
+				{
+					/* Out of memory the loudness is gated over the blocks held so far */
+					double* grown = realloc(pAnalysis->blocks, pAnalysis->blockcapacity * 2 * sizeof(double));
+					if(grown)
+					{
+						pAnalysis->blocks = grown;
+						pAnalysis->blockcapacity *= 2;
+					}
+				}
+				if(pAnalysis->blockcount < pAnalysis->blockcapacity)
+				{
+					pAnalysis->blocks[pAnalysis->blockcount++] = (pAnalysis->recent[0] + pAnalysis->recent[1]
+					   + pAnalysis->recent[2] + pAnalysis->recent[3]) / (4.0 * pAnalysis->step);
+				}
+			}
+		}
+	}
+}
+
+double tr_analysis_loudness(const tr_analysis* pAnalysis)
+{
+	double absolute = pow(10.0, (TR_ANALYSIS_ABSOLUTE_GATE + 0.691) / 10.0);
+	double sum = 0.0;
+	unsigned int count = 0;
+	unsigned int i;
+	
+	for(i = 0; i < pAnalysis->blockcount; i++)
+	{
+		if(pAnalysis->blocks[i] > absolute)
+		{
+			sum += pAnalysis->blocks[i];
+			++count;
+		}
+	}
+	if(count == 0)
+	{
+		return -HUGE_VAL;
+	}
+	
+	double relative = sum / count * pow(10.0, TR_ANALYSIS_RELATIVE_GATE / 10.0);
+	sum   = 0.0;
+	count = 0;
+	for(i = 0; i < pAnalysis->blockcount; i++)
+	{
+		if(pAnalysis->blocks[i] > absolute && pAnalysis->blocks[i] > relative)
+		{
+			sum += pAnalysis->blocks[i];
+			++count;
+		}
+	}
+	return count ? -0.691 + 10.0 * log10(sum / count) : -HUGE_VAL;
+}
+
+double tr_analysis_truepeak(const tr_analysis* pAnalysis)
+{
+	double peak = 0.0;
+	unsigned int c;
+	for(c = 0; c < pAnalysis->channels; c++)
+	{
+		peak = pAnalysis->truepeak[c] > peak ? pAnalysis->truepeak[c] : peak;
+		peak = pAnalysis->samplepeak[c] > peak ? pAnalysis->samplepeak[c] : peak;
+	}
+	return peak;
+}
+
+void tr_analysis_json(const tr_analysis* pAnalysis, FILE* pFile, const char* pName, double pGain, double pTarget, double pLimit)
+{
+	unsigned int channels = pAnalysis->channels;
+	double frames   = pAnalysis->frames > 0 ? (double)pAnalysis->frames : 1.0;
+	double gaindb   = 20.0 * log10(pGain);
+	double power    = pGain * pGain;
+	double loudness = tr_analysis_loudness(pAnalysis);
+	double square = 0.0, samplepeak = 0.0, truepeak = 0.0, bandtotal = 0.0;
+	unsigned int c, b;
+	
+	for(c = 0; c < channels; c++)
+	{
+		square += pAnalysis->square[c];
+		samplepeak = pAnalysis->samplepeak[c] > samplepeak ? pAnalysis->samplepeak[c] : samplepeak;
+		truepeak   = pAnalysis->truepeak[c] > truepeak ? pAnalysis->truepeak[c] : truepeak;
+	}
+	for(b = 0; b < pAnalysis->bands; b++)
+	{
+		bandtotal += pAnalysis->bandenergy[b];
+	}
+	
+	fprintf(pFile, "{\n");
+	fprintf(pFile, "  \"file\": \"");
+	for(; *pName; pName++)
+	{
+		if(*pName == '"' || *pName == '\\')
+		{
+			fputc('\\', pFile);
+			fputc(*pName, pFile);
+		}
+		else if((unsigned char)*pName < 0x20)
+		{
+			fprintf(pFile, "\\u%04x", (unsigned char)*pName);
+		}
+		else
+		{
+			fputc(*pName, pFile);
+		}
+	}
+	fprintf(pFile, "\",\n");
+	fprintf(pFile, "  \"gain_db\": %.2f,\n", gaindb);
+	if(pTarget > -HUGE_VAL)
+	{
+		fprintf(pFile, "  \"target_lufs\": %.2f,\n", pTarget);
+		if(pLimit > 0.0)
+		{
+			fprintf(pFile, "  \"true_peak_limit_db\": %.2f,\n", 20.0 * log10(pLimit));
+		}
+		fprintf(pFile, "  \"limited\": %s,\n", pLimit > 0.0 && pGain >= pLimit * (1.0 - 1e-6) ? "true" : "false");
+	}
+	if(loudness > -HUGE_VAL)
+	{
+		fprintf(pFile, "  \"integrated_lufs\": %.2f,\n", loudness + gaindb);
+	}
+	else
+	{
+		fprintf(pFile, "  \"integrated_lufs\": null,\n");
+	}
+	fprintf(pFile, "  \"true_peak_dbtp\": %.2f,\n", tr_analysis_db(truepeak * truepeak * power));
+	fprintf(pFile, "  \"sample_peak_dbfs\": %.2f,\n", tr_analysis_db(samplepeak * samplepeak * power));
+	fprintf(pFile, "  \"rms_dbfs\": %.2f,\n", tr_analysis_db(square / (frames * channels) * power));
+	
+	fprintf(pFile, "  \"channels\": [\n");
+	for(c = 0; c < channels; c++)
+	{
+		fprintf(pFile, "    { \"rms_dbfs\": %.2f, \"true_peak_dbtp\": %.2f, \"sample_peak_dbfs\": %.2f }%s\n",
+		   tr_analysis_db(pAnalysis->square[c] / frames * power),
+		   tr_analysis_db((double)pAnalysis->truepeak[c] * pAnalysis->truepeak[c] * power),
+		   tr_analysis_db((double)pAnalysis->samplepeak[c] * pAnalysis->samplepeak[c] * power),
+		   c + 1 < channels ? "," : "");
+	}
+	fprintf(pFile, "  ],\n");
+	
+	fprintf(pFile, "  \"bands\": [\n");
+	for(b = 0; b < pAnalysis->bands; b++)
+	{
+		fprintf(pFile, "    { \"centre_hz\": %.2f, \"energy_dbfs\": %.2f, \"share\": %.4f }%s\n",
+		   31.25 * (1u << b), tr_analysis_db(pAnalysis->bandenergy[b] / (frames * channels) * power),
+		   bandtotal > 0.0 ? pAnalysis->bandenergy[b] / bandtotal : 0.0, b + 1 < pAnalysis->bands ? "," : "");
+	}
+	fprintf(pFile, "  ]\n");
+	fprintf(pFile, "}\n");
+}
+
+/**
+	Direct form II transposed
+*/
+double tr_biquad_run(const tr_biquad* pFilter, double* pState, double pInput)
+{
+	double output = pFilter->b0 * pInput + pState[0];
+	pState[0] = pFilter->b1 * pInput - pFilter->a1 * output + pState[1];
+	pState[1] = pFilter->b2 * pInput - pFilter->a2 * output;
+	return output;
+}
+
+/* Power to dB, silence is clamped so the JSON stays numeric */
+double tr_analysis_db(double pPower)
+{
+	return pPower > 1e-20 ? 10.0 * log10(pPower) : -200.0;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
@@ -0,0 +1,208 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "automation.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+static int tr_automation_compare(const void* pA, const void* pB);
+
+
+int tr_automation_compare(const void* pA, const void* pB)
+{
+	const tr_automation_event* a = pA;
+	const tr_automation_event* b = pB;
+	return a->frame < b->frame ? -1 : a->frame > b->frame;
+}
+
+int tr_automation_load(tr_automation* pAuto, const char* pFilename, const char* pInitial, unsigned int pSampleRate)
+{
+	FILE* file = fopen(pFilename, "r");
+	if(file == 0)
+	{
+		return 0;
+	}
+	
+	unsigned int capacity = 8;
+	pAuto->count  = 0;
+	pAuto->events = malloc(capacity * sizeof(tr_automation_event));
+	if(!pAuto->events)
+	{
+		fclose(file);
+		return 0;
+	}
+	pAuto->events[0].frame    = 0;
+	pAuto->events[0].filename = strdup(pInitial);
+	pAuto->count  = 1;
+	
+	/* Every error return frees the events read so far */
+	int ok = pAuto->events[0].filename != 0;
+	char line[1024];
+	while(ok && fgets(line, sizeof(line), file))
+	{
+		char* text = line + strspn(line, " \t");
+		if(*text == '#' || *text == '\n' || *text == '\r' || *text == '\0')
+		{
+			continue;
+		}
+		
+		char* end;
+		double seconds = strtod(text, &end);
+		if(end == text || seconds < 0.0)
+		{
+			ok = 0;
+			break;
+		}
+		
+		/* The rest of the line is the filename */
+		end += strspn(end, " \t");
+		end[strcspn(end, "\r\n")] = '\0';
+		if(*end == '\0')
+		{
+			ok = 0;
+			break;
+		}
+		
+		if(pAuto->count == capacity)
+		{
+			tr_automation_event* events = realloc(pAuto->events, capacity * 2 * sizeof(tr_automation_event));
+			if(!events)
+			{
+				ok = 0;
+				break;
+			}
+			pAuto->events = events;
+			capacity *= 2;
+		}
+		pAuto->events[pAuto->count].frame    = seconds * pSampleRate + 0.5;
+		pAuto->events[pAuto->count].filename = strdup(end);
+		if(!pAuto->events[pAuto->count].filename)
+		{
+			ok = 0;
+			break;
+		}
+		++pAuto->count;
+	}
+	fclose(file);
+	
+	if(!ok)
+	{
+		tr_automation_free(pAuto);
+		return 0;
+	}
+	
+	/* The initial response stays in front, only the file events are sorted */
+	qsort(pAuto->events + 1, pAuto->count - 1, sizeof(tr_automation_event), tr_automation_compare);
+	return 1;
+}
+
+void tr_automation_free(tr_automation* pAuto)
+{
+	unsigned int i;
+	for(i = 0; i < pAuto->count; i++)
+	{
+		free(pAuto->events[i].filename);
+	}
+	free(pAuto->events);
+	pAuto->events = NULL;
+	pAuto->count  = 0;
+}
+
+/**
+	Each event fades in over whatever was playing when it started, so a switch during
+	a fade starts from the mix so far and every event inside one block is heard.  Only
+	events from the last one whose fade had finished are pulled for a block.
+*/
+void tr_automation_render(const tr_automation* pAuto, const tr_irspectra** pResponses, tr_convolver* pConv,
+                          const float* pInput, unsigned int pInLen, float* pOutput, unsigned int pOutLen, unsigned int pFade)
+{
+	unsigned int blocksize = pConv->blocksize;
+	float* block = malloc(blocksize * sizeof(float));
+	float* faded = malloc(blocksize * sizeof(float));
+	
+	unsigned int base = 0;   /* event playing alone at the start of the block */
+	unsigned int last = 0;   /* latest event started by the end of the block */
+	
+	if(pFade == 0)
+	{
+		pFade = 1;
+	}
+	
+	unsigned int pos;
+	for(pos = 0; pos < pOutLen; pos += blocksize)
+	{
+		unsigned int count = pos < pInLen ? pInLen - pos : 0;
+		if(count > blocksize)
+		{
+			count = blocksize;
+		}
+		memcpy(block, pInput + pos, count * sizeof(float));
+		memset(block + count, 0, (blocksize - count) * sizeof(float));
+		tr_convolver_push(pConv, block);
+		
+		while(base + 1 < pAuto->count && pAuto->events[base + 1].frame + pFade <= pos)
+		{
+			++base;
+		}
+		while(last + 1 < pAuto->count && pAuto->events[last + 1].frame < pos + blocksize)
+		{
+			++last;
+		}
+		
+		tr_convolver_pull(pConv, pResponses[base], block);
+		
+		unsigned int e;
+		for(e = base + 1; e <= last; e++)
+		{
+			unsigned int fadestart = pAuto->events[e].frame;
+			tr_convolver_pull(pConv, pResponses[e], faded);
+			
+			unsigned int n;
+			for(n = 0; n < blocksize; n++)
+			{
+				float mix = pos + n < fadestart ? 0.0f : (float)(pos + n - fadestart) / pFade;
+				if(mix < 1.0f)
+				{
+					block[n] = block[n] + mix * (faded[n] - block[n]);
+				}
+				else
+				{
+					block[n] = faded[n];
+				}
+			}
+		}
+		
+		memcpy(pOutput + pos, block, (pOutLen - pos < blocksize ? pOutLen - pos : blocksize) * sizeof(float));
+	}
+	
+	free(block);
+	free(faded);
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
@@ -0,0 +1,500 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "batch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define TR_BATCH_TILE  1024  /* accumulator floats, real and imaginary, per sweep over the partitions */
+
+static inline void tr_batch_radix2(float* restrict pAr, float* restrict pAi, float* restrict pBr, float* restrict pBi,
+                                   float pWr, float pWi, unsigned int pLanes);
+static inline void tr_batch_radix4(float* restrict pAr, float* restrict pAi, float* restrict pBr, float* restrict pBi,
+                                   float* restrict pCr, float* restrict pCi, float* restrict pDr, float* restrict pDi,
+                                   const float* pTwiddles, unsigned int pLanes);
+static void tr_batch_butterflies(const tr_batch_fft* pFFT, float* pData);
+static void tr_batch_butterflies4(const tr_batch_fft* pFFT, float* pData);
+static void tr_batch_mac(const float* pXre, const float* pXim, const float* pHre, const float* pHim, float* pAccre, float* pAccim, unsigned int pCount);
+
+
+unsigned int tr_batch_lanes(unsigned int pChannels)
+{
+	unsigned int lanes = TR_BATCH_MAX_LANES;
+	while(lanes >= TR_BATCH_MIN_LANES && lanes > pChannels)
+	{
+		lanes /= 2;
+	}
+	return lanes >= TR_BATCH_MIN_LANES ? lanes : 0;
+}
+
+unsigned int tr_batch_blocksize(unsigned int pBlockSize, unsigned int pLength)
+{
+	/* Batched transforms are cheap enough that fewer, bigger partitions pay */
+	unsigned int blocksize = pBlockSize;
+	while(blocksize < TR_BATCH_MAX_BLOCK && (pLength + blocksize - 1) / blocksize > TR_BATCH_MAX_PARTITIONS)
+	{
+		blocksize *= 2;
+	}
+	return (pLength + blocksize - 1) / blocksize > TR_BATCH_MAX_PARTITIONS ? 0 : blocksize;
+}
+
+int tr_batch_fft_init(tr_batch_fft* pFFT, unsigned int pSize, unsigned int pLanes)
+{
+	if( !tr_fft_init(&pFFT->tables, pSize) )
+	{
+		return 0;
+	}
+	
+	pFFT->lanes = pLanes;
+	pFFT->work  = malloc(pSize * pLanes * sizeof(float));
+	if(!pFFT->work)
+	{
+		tr_fft_free(&pFFT->tables);
+		return 0;
+	}
+	return 1;
+}
+
+void tr_batch_fft_free(tr_batch_fft* pFFT)
+{
+	tr_fft_free(&pFFT->tables);
+	free(pFFT->work);
+}
+
+/**
+	One butterfly of every lane.  The four rows never overlap, saying so with restrict
+	spares a runtime overlap check in front of every short loop over the lanes.
+*/
+void tr_batch_radix2(float* restrict pAr, float* restrict pAi, float* restrict pBr, float* restrict pBi,
+                     float pWr, float pWi, unsigned int pLanes)
+{
+	unsigned int l;
+	for(l = 0; l < pLanes; l++)
+	{
+		float vr = pBr[l] * pWr - pBi[l] * pWi;
+		float vi = pBr[l] * pWi + pBi[l] * pWr;
+		
+		pBr[l] = pAr[l] - vr;
+		pBi[l] = pAi[l] - vi;
+		pAr[l] += vr;
+		pAi[l] += vi;
+	}
+}
+
+/**
+	Two passes of the radix 4 sweep over complex values a, b, c and d of every lane,
+	with the real and imaginary rows passed apart for the same reason
+*/
+void tr_batch_radix4(float* restrict pAr, float* restrict pAi, float* restrict pBr, float* restrict pBi,
+                     float* restrict pCr, float* restrict pCi, float* restrict pDr, float* restrict pDi,
+                     const float* pTwiddles, unsigned int pLanes)
+{
+	float w1r = pTwiddles[0], w1i = pTwiddles[1];
+	float w2r = pTwiddles[2], w2i = pTwiddles[3];
+	float w3r = pTwiddles[4], w3i = pTwiddles[5];
+	unsigned int l;
+	
+	for(l = 0; l < pLanes; l++)
+	{
+		/* len point pass over (a,b) and (c,d) */
+		float tr = pBr[l] * w1r - pBi[l] * w1i;
+		float ti = pBr[l] * w1i + pBi[l] * w1r;
+		float a1r = pAr[l] + tr, a1i = pAi[l] + ti;
+		float b1r = pAr[l] - tr, b1i = pAi[l] - ti;
+		
+		tr = pDr[l] * w1r - pDi[l] * w1i;
+		ti = pDr[l] * w1i + pDi[l] * w1r;
+		float c1r = pCr[l] + tr, c1i = pCi[l] + ti;
+		float d1r = pCr[l] - tr, d1i = pCi[l] - ti;
+		
+		/* 2*len point pass over (a,c) and (b,d) */
+		tr = c1r * w2r - c1i * w2i;
+		ti = c1r * w2i + c1i * w2r;
+		pAr[l] = a1r + tr;  pAi[l] = a1i + ti;
+		pCr[l] = a1r - tr;  pCi[l] = a1i - ti;
+		
+		tr = d1r * w3r - d1i * w3i;
+		ti = d1r * w3i + d1i * w3r;
+		pBr[l] = b1r + tr;  pBi[l] = b1i + ti;
+		pDr[l] = b1r - tr;  pDi[l] = b1i - ti;
+	}
+}
+
+/**
+	The passes of tr_fft_butterflies, complex value i of lane l has its real part at
+	pData[2*i*lanes + l] and its imaginary part lanes further on
+*/
+void tr_batch_butterflies(const tr_batch_fft* pFFT, float* pData)
+{
+	const tr_fft* tables = &pFFT->tables;
+	unsigned int half  = tables->size / 2;
+	unsigned int lanes = pFFT->lanes;
+	unsigned int len;
+	
+	if(tables->radix == 4)
+	{
+		tr_batch_butterflies4(pFFT, pData);
+		return;
+	}
+	
+	for(len = 2; len <= half; len <<= 1)
+	{
+		unsigned int step = half / len;
+		unsigned int mid  = len / 2;
+		unsigned int i;
+		
+		for(i = 0; i < half; i += len)
+		{
+			unsigned int j;
+			for(j = 0; j < mid; j++)
+			{
+				float* ar = pData + 2*(i + j) * lanes;
+				float* ai = ar + lanes;
+				float* br = pData + 2*(i + j + mid) * lanes;
+				float* bi = br + lanes;
+				
+				tr_batch_radix2(ar, ai, br, bi, tables->twiddle[2*j*step], tables->twiddle[2*j*step+1], lanes);
+			}
+		}
+	}
+}
+
+/**
+	The passes of tr_fft_butterflies4, two per sweep
+*/
+void tr_batch_butterflies4(const tr_batch_fft* pFFT, float* pData)
+{
+	const tr_fft* tables = &pFFT->tables;
+	unsigned int half  = tables->size / 2;
+	unsigned int lanes = pFFT->lanes;
+	unsigned int len   = 2;
+	unsigned int i, l;
+	
+	unsigned int passes = 0;
+	while((1u << passes) < half)
+	{
+		++passes;
+	}
+	if(passes & 1)
+	{
+		for(i = 0; i < half; i += 2)
+		{
+			float* ar = pData + 2*i * lanes;
+			float* ai = ar + lanes;
+			float* br = ai + lanes;
+			float* bi = br + lanes;
+			for(l = 0; l < lanes; l++)
+			{
+				float tr = br[l];
+				float ti = bi[l];
+				br[l] = ar[l] - tr;
+				bi[l] = ai[l] - ti;
+				ar[l] += tr;
+				ai[l] += ti;
+			}
+		}
+		len = 4;
+	}
+	
+	for(; len < half; len *= 4)
+	{
+		unsigned int quarter = len / 2;
+		unsigned int step1   = half / len;
+		unsigned int step2   = half / (len * 2);
+		
+		for(i = 0; i < half; i += len * 2)
+		{
+			unsigned int j;
+			for(j = 0; j < quarter; j++)
+			{
+				float* a = pData + 2*(i + j) * lanes;
+				float* b = a + 2*quarter * lanes;
+				float* c = a + 2*len * lanes;
+				float* d = c + 2*quarter * lanes;
+				
+				float twiddles[6];
+				twiddles[0] = tables->twiddle[2*j*step1];
+				twiddles[1] = tables->twiddle[2*j*step1+1];
+				twiddles[2] = tables->twiddle[2*j*step2];
+				twiddles[3] = tables->twiddle[2*j*step2+1];
+				twiddles[4] = tables->twiddle[2*(j+quarter)*step2];
+				twiddles[5] = tables->twiddle[2*(j+quarter)*step2+1];
+				
+				tr_batch_radix4(a, a + lanes, b, b + lanes, c, c + lanes, d, d + lanes, twiddles, lanes);
+			}
+		}
+	}
+}
+
+void tr_batch_fft_forward(tr_batch_fft* pFFT, const float* pInput, float* pSpectrum)
+{
+	const tr_fft* tables = &pFFT->tables;
+	unsigned int half  = tables->size / 2;
+	unsigned int lanes = pFFT->lanes;
+	float* work = pFFT->work;
+	float* re   = pSpectrum;
+	float* im   = pSpectrum + (half + 1) * lanes;
+	
+	/* An even and odd sample of every lane is one complex value of every lane */
+	unsigned int n;
+	for(n = 0; n < half; n++)
+	{
+		memcpy(work + 2*tables->bitrev[n] * lanes, pInput + 2*n * lanes, 2 * lanes * sizeof(float));
+	}
+	
+	tr_batch_butterflies(pFFT, work);
+	
+	unsigned int k;
+	for(k = 0; k <= half; k++)
+	{
+		unsigned int a = k == half ? 0 : k;
+		unsigned int b = k == 0 ? 0 : half - k;
+		const float* war = work + 2*a * lanes;
+		const float* wai = war + lanes;
+		const float* wbr = work + 2*b * lanes;
+		const float* wbi = wbr + lanes;
+		float* rek = re + k * lanes;
+		float* imk = im + k * lanes;
+		float wr = tables->split[2*k];
+		float wi = tables->split[2*k+1];
+		unsigned int l;
+		
+		for(l = 0; l < lanes; l++)
+		{
+			float er = 0.5f * (war[l] + wbr[l]);
+			float ei = 0.5f * (wai[l] - wbi[l]);
+			float odr = 0.5f * (wai[l] + wbi[l]);
+			float odi = 0.5f * (wbr[l] - war[l]);
+			
+			rek[l] = er + odr * wr - odi * wi;
+			imk[l] = ei + odr * wi + odi * wr;
+		}
+	}
+}
+
+void tr_batch_fft_inverse(tr_batch_fft* pFFT, const float* pSpectrum, float* pOutput)
+{
+	const tr_fft* tables = &pFFT->tables;
+	unsigned int half  = tables->size / 2;
+	unsigned int lanes = pFFT->lanes;
+	float* work     = pFFT->work;
+	const float* re = pSpectrum;
+	const float* im = pSpectrum + (half + 1) * lanes;
+	
+	unsigned int k, l;
+	for(k = 0; k < half; k++)
+	{
+		const float* rek = re + k * lanes;
+		const float* imk = im + k * lanes;
+		const float* rem = re + (half - k) * lanes;
+		const float* imm = im + (half - k) * lanes;
+		float* destr = work + 2*tables->bitrev[k] * lanes;
+		float* desti = destr + lanes;
+		float wr = tables->split[2*k];
+		float wi = -tables->split[2*k+1];
+		
+		for(l = 0; l < lanes; l++)
+		{
+			float er = 0.5f * (rek[l] + rem[l]);
+			float ei = 0.5f * (imk[l] - imm[l]);
+			float dr = 0.5f * (rek[l] - rem[l]);
+			float di = 0.5f * (imk[l] + imm[l]);
+			float odr = dr * wr - di * wi;
+			float odi = dr * wi + di * wr;
+			
+			destr[l] = er - odi;
+			desti[l] = -(ei + odr);
+		}
+	}
+	
+	tr_batch_butterflies(pFFT, work);
+	
+	const float scale = 1.0f / half;
+	unsigned int n;
+	for(n = 0; n < half; n++)
+	{
+		const float* wr = work + 2*n * lanes;
+		const float* wi = wr + lanes;
+		float* outr = pOutput + 2*n * lanes;
+		float* outi = outr + lanes;
+		for(l = 0; l < lanes; l++)
+		{
+			outr[l] = wr[l] * scale;
+		}
+		for(l = 0; l < lanes; l++)
+		{
+			outi[l] = -wi[l] * scale;
+		}
+	}
+}
+
+int tr_batch_convolver_init(tr_batch_convolver* pConv, unsigned int pBlockSize, unsigned int pPartitions, unsigned int pLanes)
+{
+	if( !tr_batch_fft_init(&pConv->fft, pBlockSize * 2, pLanes) )
+	{
+		return 0;
+	}
+	
+	unsigned int spectrum = TR_FFT_SPECTRUM(pBlockSize * 2) * pLanes;
+	pConv->blocksize  = pBlockSize;
+	pConv->partitions = pPartitions > 0 ? pPartitions : 1;
+	pConv->current    = 0;
+	pConv->lanes      = pLanes;
+	pConv->input      = calloc(pBlockSize * 2 * pLanes, sizeof(float));
+	pConv->delayline  = calloc((size_t)pConv->partitions * spectrum, sizeof(float));
+	pConv->accum      = malloc(spectrum * sizeof(float));
+	pConv->output     = malloc(pBlockSize * 2 * pLanes * sizeof(float));
+	if(!pConv->input || !pConv->delayline || !pConv->accum || !pConv->output)
+	{
+		tr_batch_convolver_free(pConv);
+		return 0;
+	}
+	return 1;
+}
+
+void tr_batch_convolver_free(tr_batch_convolver* pConv)
+{
+	tr_batch_fft_free(&pConv->fft);
+	free(pConv->input);
+	free(pConv->delayline);
+	free(pConv->accum);
+	free(pConv->output);
+}
+
+void tr_batch_convolver_push(tr_batch_convolver* pConv, const float* pInput)
+{
+	unsigned int block    = pConv->blocksize * pConv->lanes;
+	unsigned int spectrum = TR_FFT_SPECTRUM(pConv->blocksize * 2) * pConv->lanes;
+	
+	memmove(pConv->input, pConv->input + block, block * sizeof(float));
+	memcpy(pConv->input + block, pInput, block * sizeof(float));
+	
+	pConv->current = pConv->current == 0 ? pConv->partitions - 1 : pConv->current - 1;
+	tr_batch_fft_forward(&pConv->fft, pConv->input, pConv->delayline + (size_t)pConv->current * spectrum);
+}
+
+void tr_batch_convolver_pull(tr_batch_convolver* pConv, const tr_batch_spectra* pResponse, float* pOutput)
+{
+	unsigned int block      = pConv->blocksize * pConv->lanes;
+	unsigned int spectrum   = TR_FFT_SPECTRUM(pConv->blocksize * 2) * pConv->lanes;
+	unsigned int count      = (pConv->blocksize + 1) * pConv->lanes;
+	unsigned int partitions = pResponse->partitions < pConv->partitions ? pResponse->partitions : pConv->partitions;
+	
+	memset(pConv->accum, 0, spectrum * sizeof(float));
+	
+	/* A batch accumulator is lanes times the size of a single channel one, so it is
+	   filled a tile at a time over every partition while the tile stays in cache */
+	unsigned int tile;
+	for(tile = 0; tile < count; tile += TR_BATCH_TILE)
+	{
+		unsigned int bins = count - tile < TR_BATCH_TILE ? count - tile : TR_BATCH_TILE;
+		
+		/* Newest input against the first partition, walking back through the delay line */
+		unsigned int slot = pConv->current;
+		unsigned int p;
+		for(p = 0; p < partitions; p++)
+		{
+			const float* xre = pConv->delayline + (size_t)slot * spectrum + tile;
+			const float* hre = pResponse->spectra + (size_t)p * spectrum + tile;
+			tr_batch_mac(xre, xre + count, hre, hre + count, pConv->accum + tile, pConv->accum + count + tile, bins);
+			
+			slot = slot + 1 == pConv->partitions ? 0 : slot + 1;
+		}
+	}
+	
+	/* Overlap-save, the second half holds the linear part of the circular convolution */
+	tr_batch_fft_inverse(&pConv->fft, pConv->accum, pConv->output);
+	memcpy(pOutput, pConv->output + block, block * sizeof(float));
+}
+
+/**
+	Complex multiply-accumulate of one partition of every lane, lanes of a bin
+	sit next to each other so this is the same loop as tr_convolver_mac
+*/
+void tr_batch_mac(const float* pXre, const float* pXim, const float* pHre, const float* pHim, float* pAccre, float* pAccim, unsigned int pCount)
+{
+	unsigned int k;
+	for(k = 0; k < pCount; k++)
+	{
+		pAccre[k] += pXre[k] * pHre[k] - pXim[k] * pHim[k];
+		pAccim[k] += pXre[k] * pHim[k] + pXim[k] * pHre[k];
+	}
+}
+
+int tr_batch_spectra_init(tr_batch_spectra* pSpectra, tr_batch_fft* pFFT, const float* pResponse, unsigned int pChannels,
+                          unsigned int pFirst, unsigned int pLength)
+{
+	unsigned int blocksize = pFFT->tables.size / 2;
+	unsigned int lanes     = pFFT->lanes;
+	unsigned int spectrum  = TR_FFT_SPECTRUM(blocksize * 2) * lanes;
+	
+	pSpectra->blocksize  = blocksize;
+	pSpectra->partitions = (pLength + blocksize - 1) / blocksize;
+	pSpectra->lanes      = lanes;
+	pSpectra->spectra    = malloc((size_t)pSpectra->partitions * spectrum * sizeof(float));
+	if(!pSpectra->spectra)
+	{
+		return 0;
+	}
+	
+	/* Each partition sits in the first half of a zero padded transform */
+	float* padded = calloc(blocksize * 2 * lanes, sizeof(float));
+	if(!padded)
+	{
+		tr_batch_spectra_free(pSpectra);
+		return 0;
+	}
+	unsigned int p;
+	for(p = 0; p < pSpectra->partitions; p++)
+	{
+		unsigned int count = pLength - p * blocksize < blocksize ? pLength - p * blocksize : blocksize;
+		unsigned int f, l;
+		for(f = 0; f < count; f++)
+		{
+			const float* frame = pResponse + (size_t)(p * blocksize + f) * pChannels + pFirst;
+			for(l = 0; l < lanes; l++)
+			{
+				padded[f * lanes + l] = frame[l];
+			}
+		}
+		memset(padded + count * lanes, 0, (blocksize * 2 - count) * lanes * sizeof(float));
+		
+		tr_batch_fft_forward(pFFT, padded, pSpectra->spectra + (size_t)p * spectrum);
+	}
+	free(padded);
+	
+	return 1;
+}
+
+void tr_batch_spectra_free(tr_batch_spectra* pSpectra)
+{
+	free(pSpectra->spectra);
+	pSpectra->spectra = NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
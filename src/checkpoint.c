@@ -0,0 +1,112 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "checkpoint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define TR_CHECKPOINT_MAGIC    0x54524350  /* 'TRCP' */
+#define TR_CHECKPOINT_VERSION  2
+
+
+int tr_checkpoint_save(const char* pFilename, const tr_checkpoint* pCheckpoint, const tr_stream* pStream)
+{
+	char* tempname = malloc(strlen(pFilename) + 5);
+	strcpy(tempname, pFilename);
+	strcat(tempname, ".tmp");
+	
+	FILE* file = fopen(tempname, "wb");
+	if(file == 0)
+	{
+		free(tempname);
+		return 0;
+	}
+	
+	uint32_t header[2] = { TR_CHECKPOINT_MAGIC, TR_CHECKPOINT_VERSION };
+	int ok = fwrite(header, sizeof(uint32_t), 2, file) == 2
+	      && fwrite(pCheckpoint, sizeof(tr_checkpoint), 1, file) == 1
+	      && tr_stream_save(pStream, file);
+	
+	if(fclose(file) != 0)
+	{
+		ok = 0;
+	}
+	
+	if(ok)
+	{
+#ifdef _WIN32
+		remove(pFilename); /* rename will not replace an existing file */
+#endif
+		ok = rename(tempname, pFilename) == 0;
+	}
+	if(!ok)
+	{
+		remove(tempname);
+	}
+	
+	free(tempname);
+	return ok;
+}
+
+int tr_checkpoint_load(const char* pFilename, tr_checkpoint* pCheckpoint, tr_stream* pStream)
+{
+	FILE* file = fopen(pFilename, "rb");
+	if(file == 0)
+	{
+		return 0;
+	}
+	
+	uint32_t header[2];
+	int ok = fread(header, sizeof(uint32_t), 2, file) == 2
+	      && header[0] == TR_CHECKPOINT_MAGIC
+	      && header[1] == TR_CHECKPOINT_VERSION
+	      && fread(pCheckpoint, sizeof(tr_checkpoint), 1, file) == 1;
+	
+	if(ok && pStream)
+	{
+		ok = tr_stream_load(pStream, file);
+	}
+	
+	fclose(file);
+	return ok;
+}
+
+int tr_checkpoint_matches(const tr_checkpoint* pA, const tr_checkpoint* pB)
+{
+	return pA->channels       == pB->channels
+	    && pA->samplerate     == pB->samplerate
+	    && pA->inputframes    == pB->inputframes
+	    && pA->responseframes == pB->responseframes
+	    && pA->precision      == pB->precision
+	    && pA->doubleaccum    == pB->doubleaccum
+	    && pA->input          == pB->input
+	    && pA->response       == pB->response;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
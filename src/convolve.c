@@ -0,0 +1,293 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "convolve.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+static double tr_dot_double(const float* pA, const float* pB, unsigned int pCount);
+
+void tr_convolve_direct(const float* pInput, unsigned int pInLen, const float* pResponse, unsigned int pReLen, float* pOutput)
+{
+	unsigned int samplestotal = pInLen + pReLen - 1;
+	unsigned int inoffset;
+	unsigned int reoffset;
+	unsigned int n_hi;
+	unsigned int n_lo;
+	float* conv = pOutput;
+	
+	unsigned int i;
+	for(i = 0; i < samplestotal; i++)
+	{
+		n_lo = i < pReLen ? 0 : i - pReLen + 1;
+		n_hi = pInLen < i + 1 ? pInLen : i + 1;
+		
+		inoffset = n_lo;
+		reoffset = i - n_lo;
+		
+		*conv = 0.0f;
+		unsigned int n;
+		for(n = n_lo; n < n_hi; n++)
+		{
+			*conv += *(pInput+inoffset) * *(pResponse+reoffset);
+			++inoffset;
+			--reoffset;
+		}
+		conv++;
+	}
+}
+
+/**
+	Dot product of two float arrays in double, several lanes and two accumulators
+	so the adds pipeline.  The float path can not be vectorised without reordering
+	its sums, this one reorders sums of exact products held in double.
+*/
+double tr_dot_double(const float* pA, const float* pB, unsigned int pCount)
+{
+	unsigned int n = 0;
+	double sum = 0.0;
+	
+#if defined(__AVX__)
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	for(; n + 8 <= pCount; n += 8)
+	{
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(pA + n)),     _mm256_cvtps_pd(_mm_loadu_ps(pB + n))));
+		acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(pA + n + 4)), _mm256_cvtps_pd(_mm_loadu_ps(pB + n + 4))));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__SSE2__)
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	for(; n + 4 <= pCount; n += 4)
+	{
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(pA + n))),
+		                                   _mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(pB + n)))));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(pA + n + 2))),
+		                                   _mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(pB + n + 2)))));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+	sum = lanes[0] + lanes[1];
+#endif
+	
+	for(; n < pCount; n++)
+	{
+		sum += (double)pA[n] * pB[n];
+	}
+	return sum;
+}
+
+void tr_convolve_direct_double(const float* pInput, unsigned int pInLen, const float* pResponse, unsigned int pReLen, float* pOutput)
+{
+	unsigned int samplestotal = pInLen + pReLen - 1;
+	
+	/* Reversed so input and response are both walked forwards */
+	float* reversed = malloc(pReLen * sizeof(float));
+	unsigned int i;
+	for(i = 0; i < pReLen; i++)
+	{
+		reversed[i] = pResponse[pReLen - 1 - i];
+	}
+	
+	for(i = 0; i < samplestotal; i++)
+	{
+		unsigned int n_lo = i < pReLen ? 0 : i - pReLen + 1;
+		unsigned int n_hi = pInLen < i + 1 ? pInLen : i + 1;
+		
+		*pOutput++ = tr_dot_double(pInput + n_lo, reversed + (pReLen - 1 - i + n_lo), n_hi - n_lo);
+	}
+	
+	free(reversed);
+}
+
+void tr_convolve_fft(tr_convolver* pConv, const tr_irspectra* pResponse, const float* pInput, unsigned int pInLen, float* pOutput, unsigned int pOutLen)
+{
+	unsigned int blocksize = pConv->blocksize;
+	float* block = malloc(blocksize * sizeof(float));
+	
+	unsigned int pos;
+	for(pos = 0; pos < pOutLen; pos += blocksize)
+	{
+		unsigned int count = pos < pInLen ? pInLen - pos : 0;
+		if(count > blocksize)
+		{
+			count = blocksize;
+		}
+		memcpy(block, pInput + pos, count * sizeof(float));
+		memset(block + count, 0, (blocksize - count) * sizeof(float));
+		
+		tr_convolver_push(pConv, block);
+		tr_convolver_pull(pConv, pResponse, block);
+		
+		memcpy(pOutput + pos, block, (pOutLen - pos < blocksize ? pOutLen - pos : blocksize) * sizeof(float));
+	}
+	
+	free(block);
+}
+
+int tr_convolve_fft_batch(tr_batch_convolver* pConv, const tr_batch_spectra* pResponse, const float* pInput, unsigned int pChannels,
+                          unsigned int pFirst, unsigned int pInLen, float* pOutput, unsigned int pOutLen)
+{
+	unsigned int blocksize = pConv->blocksize;
+	unsigned int lanes     = pConv->lanes;
+	float* block = malloc(blocksize * lanes * sizeof(float));
+	if(!block)
+	{
+		return 0;
+	}
+	
+	unsigned int pos;
+	for(pos = 0; pos < pOutLen; pos += blocksize)
+	{
+		unsigned int count = pos < pInLen ? pInLen - pos : 0;
+		if(count > blocksize)
+		{
+			count = blocksize;
+		}
+		
+		unsigned int f, l;
+		for(f = 0; f < count; f++)
+		{
+			const float* frame = pInput + (size_t)(pos + f) * pChannels + pFirst;
+			for(l = 0; l < lanes; l++)
+			{
+				block[f * lanes + l] = frame[l];
+			}
+		}
+		memset(block + count * lanes, 0, (blocksize - count) * lanes * sizeof(float));
+		
+		tr_batch_convolver_push(pConv, block);
+		tr_batch_convolver_pull(pConv, pResponse, block);
+		
+		count = pOutLen - pos < blocksize ? pOutLen - pos : blocksize;
+		for(f = 0; f < count; f++)
+		{
+			float* frame = pOutput + (size_t)(pos + f) * pChannels + pFirst;
+			for(l = 0; l < lanes; l++)
+			{
+				frame[l] = block[f * lanes + l];
+			}
+		}
+	}
+	
+	free(block);
+	return 1;
+}
+
+void tr_convolve_fft_bus(tr_convolver* pConv, const tr_irspectra* const* pResponses, unsigned int pCount, const float* pWeights,
+                         const float* pInput, unsigned int pInLen, float** pOutputs, const unsigned int* pOutLens)
+{
+	unsigned int blocksize = pConv->blocksize;
+	float* block = malloc(blocksize * sizeof(float));
+	
+	unsigned int i, k;
+	unsigned int outlen = 0;
+	for(i = 0; i < (pWeights ? 1 : pCount); i++)
+	{
+		if(pOutLens[i] > outlen)
+		{
+			outlen = pOutLens[i];
+		}
+	}
+	if(pWeights)
+	{
+		memset(pOutputs[0], 0, outlen * sizeof(float));
+	}
+	
+	unsigned int pos;
+	for(pos = 0; pos < outlen; pos += blocksize)
+	{
+		unsigned int count = pos < pInLen ? pInLen - pos : 0;
+		if(count > blocksize)
+		{
+			count = blocksize;
+		}
+		memcpy(block, pInput + pos, count * sizeof(float));
+		memset(block + count, 0, (blocksize - count) * sizeof(float));
+		
+		tr_convolver_push(pConv, block);
+		
+		for(i = 0; i < pCount; i++)
+		{
+			float* output = pOutputs[pWeights ? 0 : i];
+			unsigned int len = pOutLens[pWeights ? 0 : i];
+			if(pos >= len)
+			{
+				continue;
+			}
+			count = len - pos < blocksize ? len - pos : blocksize;
+			
+			tr_convolver_pull(pConv, pResponses[i], block);
+			
+			if(pWeights)
+			{
+				for(k = 0; k < count; k++)
+				{
+					output[pos + k] += pWeights[i] * block[k];
+				}
+			}
+			else
+			{
+				memcpy(output + pos, block, count * sizeof(float));
+			}
+		}
+	}
+	
+	free(block);
+}
+
+void tr_deinterleave(const float* pSource, float* pDest, unsigned int pChannels, unsigned int pChannel, unsigned int pFrames)
+{
+	pSource += pChannel;
+	while(pFrames-- > 0)
+	{
+		*pDest++ = *pSource;
+		pSource += pChannels;
+	}
+}
+
+void tr_interleave(const float* pSource, float* pDest, unsigned int pChannels, unsigned int pChannel, unsigned int pFrames)
+{
+	pDest += pChannel;
+	while(pFrames-- > 0)
+	{
+		*pDest = *pSource++;
+		pDest += pChannels;
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
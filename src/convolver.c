@@ -0,0 +1,526 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "convolver.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__F16C__) || defined(__AVX__)
+	#include <immintrin.h>
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define TR_CONVOLVER_MIN_BLOCK  64
+#define TR_CONVOLVER_MAX_BLOCK  8192
+
+/* Largest partition value after scaling for half storage, leaves headroom below 65504 */
+#define TR_HALF_RANGE  16384.0f
+
+static void tr_convolver_mac(const float* pXre, const float* pXim, const float* pHre, const float* pHim, float* pAccre, float* pAccim, unsigned int pBins);
+static void tr_convolver_mac_half(const float* pXre, const float* pXim, const uint16_t* pHre, const uint16_t* pHim, float pScale, float* pAccre, float* pAccim, unsigned int pBins);
+static void tr_convolver_mac_bfloat16(const float* pXre, const float* pXim, const uint16_t* pHre, const uint16_t* pHim, float* pAccre, float* pAccim, unsigned int pBins);
+static void tr_convolver_mac_double(const float* pXre, const float* pXim, const float* pHre, const float* pHim, double* pAccre, double* pAccim, unsigned int pBins);
+static const float* tr_irspectra_partition(const tr_irspectra* pSpectra, unsigned int pPartition, float* pScratch);
+
+
+/**
+	Scalar conversions, round to nearest even
+	See:  http://www.fox-toolkit.org/ftp/fasthalffloatconversion.pdf
+*/
+static inline uint16_t tr_float_to_half(float pVar)
+{
+	union { float f; uint32_t u; } bits;
+	bits.f = pVar;
+	
+	uint16_t sign     = (bits.u >> 16) & 0x8000;
+	int      exponent = ((bits.u >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits.u & 0x007fffff;
+	
+	if(exponent >= 31)
+	{
+		return sign | 0x7c00; /* overflow to infinity */
+	}
+	if(exponent <= 0)
+	{
+		if(exponent < -10)
+		{
+			return sign; /* underflow to zero */
+		}
+		/* Subnormal, shift the implicit bit in */
+		mantissa |= 0x00800000;
+		unsigned int shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t mid  = 1u << (shift - 1);
+		if(rest > mid || (rest == mid && (half & 1)))
+		{
+			++half;
+		}
+		return sign | half;
+	}
+	
+	uint32_t half = (exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	if(rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+	{
+		++half; /* may carry into the exponent, which is still correct */
+	}
+	return sign | half;
+}
+
+/* Rebias by a float multiply, exact for normals and subnormals.  Stored spectra never hold inf or nan */
+static inline float tr_half_to_float(uint16_t pVar)
+{
+	union { float f; uint32_t u; } bits;
+	bits.u = (uint32_t)(pVar & 0x7fff) << 13;
+	bits.f *= 0x1p112f;
+	bits.u |= (uint32_t)(pVar & 0x8000) << 16;
+	return bits.f;
+}
+
+static inline uint16_t tr_float_to_bfloat16(float pVar)
+{
+	union { float f; uint32_t u; } bits;
+	bits.f = pVar;
+	return (bits.u + 0x7fff + ((bits.u >> 16) & 1)) >> 16;
+}
+
+static inline float tr_bfloat16_to_float(uint16_t pVar)
+{
+	union { float f; uint32_t u; } bits;
+	bits.u = (uint32_t)pVar << 16;
+	return bits.f;
+}
+
+
+/**
+	Roughly sqrt(length) balances the transforms against the spectral multiplies,
+	offline we can afford to lean towards bigger blocks
+*/
+unsigned int tr_convolver_blocksize(unsigned int pLength)
+{
+	unsigned int blocksize = TR_CONVOLVER_MIN_BLOCK;
+	while(blocksize < TR_CONVOLVER_MAX_BLOCK && (unsigned long long)blocksize * blocksize < 4ull * pLength)
+	{
+		blocksize *= 2;
+	}
+	return blocksize;
+}
+
+int tr_convolver_init(tr_convolver* pConv, unsigned int pBlockSize, unsigned int pPartitions)
+{
+	if( !tr_fft_init(&pConv->fft, pBlockSize * 2) )
+	{
+		return 0;
+	}
+	
+	pConv->blocksize  = pBlockSize;
+	pConv->partitions = pPartitions > 0 ? pPartitions : 1;
+	pConv->input      = malloc(pBlockSize * 2 * sizeof(float));
+	pConv->delayline  = malloc(pConv->partitions * TR_FFT_SPECTRUM(pBlockSize * 2) * sizeof(float));
+	pConv->accum      = malloc(TR_FFT_SPECTRUM(pBlockSize * 2) * sizeof(float));
+	pConv->accumdouble = malloc(TR_FFT_SPECTRUM(pBlockSize * 2) * sizeof(double));
+	pConv->unpacked   = malloc(TR_FFT_SPECTRUM(pBlockSize * 2) * sizeof(float));
+	pConv->output     = malloc(pBlockSize * 2 * sizeof(float));
+	pConv->doubleaccum = 0;
+	if(!pConv->input || !pConv->delayline || !pConv->accum || !pConv->accumdouble || !pConv->unpacked || !pConv->output)
+	{
+		tr_convolver_free(pConv);
+		return 0;
+	}
+	
+	tr_convolver_reset(pConv);
+	return 1;
+}
+
+void tr_convolver_free(tr_convolver* pConv)
+{
+	tr_fft_free(&pConv->fft);
+	free(pConv->input);
+	free(pConv->delayline);
+	free(pConv->accum);
+	free(pConv->accumdouble);
+	free(pConv->unpacked);
+	free(pConv->output);
+}
+
+void tr_convolver_reset(tr_convolver* pConv)
+{
+	pConv->current = 0;
+	memset(pConv->input, 0, pConv->blocksize * 2 * sizeof(float));
+	memset(pConv->delayline, 0, pConv->partitions * TR_FFT_SPECTRUM(pConv->blocksize * 2) * sizeof(float));
+}
+
+void tr_convolver_push(tr_convolver* pConv, const float* pInput)
+{
+	unsigned int blocksize = pConv->blocksize;
+	unsigned int spectrum  = TR_FFT_SPECTRUM(blocksize * 2);
+	
+	memmove(pConv->input, pConv->input + blocksize, blocksize * sizeof(float));
+	memcpy(pConv->input + blocksize, pInput, blocksize * sizeof(float));
+	
+	pConv->current = pConv->current == 0 ? pConv->partitions - 1 : pConv->current - 1;
+	tr_fft_forward(&pConv->fft, pConv->input, pConv->delayline + pConv->current * spectrum);
+}
+
+void tr_convolver_pull(tr_convolver* pConv, const tr_irspectra* pResponse, float* pOutput)
+{
+	unsigned int blocksize = pConv->blocksize;
+	unsigned int spectrum  = TR_FFT_SPECTRUM(blocksize * 2);
+	unsigned int bins      = blocksize + 1;
+	unsigned int partitions = pResponse->partitions < pConv->partitions ? pResponse->partitions : pConv->partitions;
+	
+	/* Newest input against the first partition, walking back through the delay line */
+	unsigned int slot = pConv->current;
+	unsigned int p;
+	
+	if(pConv->doubleaccum)
+	{
+		memset(pConv->accumdouble, 0, spectrum * sizeof(double));
+		for(p = 0; p < partitions; p++)
+		{
+			const float* xre = pConv->delayline + slot * spectrum;
+			const float* hre = tr_irspectra_partition(pResponse, p, pConv->unpacked);
+			tr_convolver_mac_double(xre, xre + bins, hre, hre + bins, pConv->accumdouble, pConv->accumdouble + bins, bins);
+			
+			slot = slot + 1 == pConv->partitions ? 0 : slot + 1;
+		}
+		
+		unsigned int k;
+		for(k = 0; k < spectrum; k++)
+		{
+			pConv->accum[k] = pConv->accumdouble[k];
+		}
+	}
+	else
+	{
+		memset(pConv->accum, 0, spectrum * sizeof(float));
+		float* accre = pConv->accum;
+		float* accim = pConv->accum + bins;
+		
+		for(p = 0; p < partitions; p++)
+		{
+			const float* xre = pConv->delayline + slot * spectrum;
+			const float* xim = xre + bins;
+			
+			switch(pResponse->precision)
+			{
+			case TR_IRSPECTRA_HALF:
+			{
+				const uint16_t* hre = (const uint16_t*)pResponse->spectra + p * spectrum;
+				tr_convolver_mac_half(xre, xim, hre, hre + bins, pResponse->scale[p], accre, accim, bins);
+				break;
+			}
+			case TR_IRSPECTRA_BFLOAT16:
+			{
+				const uint16_t* hre = (const uint16_t*)pResponse->spectra + p * spectrum;
+				tr_convolver_mac_bfloat16(xre, xim, hre, hre + bins, accre, accim, bins);
+				break;
+			}
+			default:
+			{
+				const float* hre = (const float*)pResponse->spectra + p * spectrum;
+				tr_convolver_mac(xre, xim, hre, hre + bins, accre, accim, bins);
+				break;
+			}
+			}
+			
+			slot = slot + 1 == pConv->partitions ? 0 : slot + 1;
+		}
+	}
+	
+	/* Overlap-save, the second half holds the linear part of the circular convolution */
+	tr_fft_inverse(&pConv->fft, pConv->accum, pConv->output);
+	memcpy(pOutput, pConv->output + blocksize, blocksize * sizeof(float));
+}
+
+int tr_convolver_save(const tr_convolver* pConv, FILE* pFile)
+{
+	uint32_t current = pConv->current;
+	size_t delayline = (size_t)pConv->partitions * TR_FFT_SPECTRUM(pConv->blocksize * 2);
+	
+	return fwrite(&current, sizeof(uint32_t), 1, pFile) == 1
+	    && fwrite(pConv->input, sizeof(float), pConv->blocksize * 2, pFile) == pConv->blocksize * 2
+	    && fwrite(pConv->delayline, sizeof(float), delayline, pFile) == delayline;
+}
+
+int tr_convolver_load(tr_convolver* pConv, FILE* pFile)
+{
+	uint32_t current;
+	size_t delayline = (size_t)pConv->partitions * TR_FFT_SPECTRUM(pConv->blocksize * 2);
+	
+	if(fread(&current, sizeof(uint32_t), 1, pFile) != 1 || current >= pConv->partitions)
+	{
+		return 0;
+	}
+	pConv->current = current;
+	
+	return fread(pConv->input, sizeof(float), pConv->blocksize * 2, pFile) == pConv->blocksize * 2
+	    && fread(pConv->delayline, sizeof(float), delayline, pFile) == delayline;
+}
+
+/**
+	Complex multiply-accumulate of one partition, acc += x * h
+*/
+void tr_convolver_mac(const float* pXre, const float* pXim, const float* pHre, const float* pHim, float* pAccre, float* pAccim, unsigned int pBins)
+{
+	unsigned int k;
+	for(k = 0; k < pBins; k++)
+	{
+		pAccre[k] += pXre[k] * pHre[k] - pXim[k] * pHim[k];
+		pAccim[k] += pXre[k] * pHim[k] + pXim[k] * pHre[k];
+	}
+}
+
+void tr_convolver_mac_half(const float* pXre, const float* pXim, const uint16_t* pHre, const uint16_t* pHim, float pScale, float* pAccre, float* pAccim, unsigned int pBins)
+{
+	unsigned int k = 0;
+	
+#if defined(__F16C__)
+	const __m256 scale = _mm256_set1_ps(pScale);
+	for(; k + 8 <= pBins; k += 8)
+	{
+		__m256 hre = _mm256_mul_ps(_mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(pHre + k))), scale);
+		__m256 him = _mm256_mul_ps(_mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(pHim + k))), scale);
+		__m256 xre = _mm256_loadu_ps(pXre + k);
+		__m256 xim = _mm256_loadu_ps(pXim + k);
+		
+		__m256 accre = _mm256_add_ps(_mm256_loadu_ps(pAccre + k), _mm256_sub_ps(_mm256_mul_ps(xre, hre), _mm256_mul_ps(xim, him)));
+		__m256 accim = _mm256_add_ps(_mm256_loadu_ps(pAccim + k), _mm256_add_ps(_mm256_mul_ps(xre, him), _mm256_mul_ps(xim, hre)));
+		_mm256_storeu_ps(pAccre + k, accre);
+		_mm256_storeu_ps(pAccim + k, accim);
+	}
+#endif
+	
+	for(; k < pBins; k++)
+	{
+		float hre = tr_half_to_float(pHre[k]) * pScale;
+		float him = tr_half_to_float(pHim[k]) * pScale;
+		pAccre[k] += pXre[k] * hre - pXim[k] * him;
+		pAccim[k] += pXre[k] * him + pXim[k] * hre;
+	}
+}
+
+void tr_convolver_mac_bfloat16(const float* pXre, const float* pXim, const uint16_t* pHre, const uint16_t* pHim, float* pAccre, float* pAccim, unsigned int pBins)
+{
+	unsigned int k = 0;
+	
+#if defined(__AVX2__)
+	for(; k + 8 <= pBins; k += 8)
+	{
+		__m256 hre = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(pHre + k))), 16));
+		__m256 him = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(pHim + k))), 16));
+		__m256 xre = _mm256_loadu_ps(pXre + k);
+		__m256 xim = _mm256_loadu_ps(pXim + k);
+		
+		__m256 accre = _mm256_add_ps(_mm256_loadu_ps(pAccre + k), _mm256_sub_ps(_mm256_mul_ps(xre, hre), _mm256_mul_ps(xim, him)));
+		__m256 accim = _mm256_add_ps(_mm256_loadu_ps(pAccim + k), _mm256_add_ps(_mm256_mul_ps(xre, him), _mm256_mul_ps(xim, hre)));
+		_mm256_storeu_ps(pAccre + k, accre);
+		_mm256_storeu_ps(pAccim + k, accim);
+	}
+#endif
+	
+	for(; k < pBins; k++)
+	{
+		float hre = tr_bfloat16_to_float(pHre[k]);
+		float him = tr_bfloat16_to_float(pHim[k]);
+		pAccre[k] += pXre[k] * hre - pXim[k] * him;
+		pAccim[k] += pXre[k] * him + pXim[k] * hre;
+	}
+}
+
+/**
+	Products of two floats are exact in double, so the only rounding left is in the sums.
+	The vector paths widen four or two bins at a time and round exactly as the scalar one.
+*/
+void tr_convolver_mac_double(const float* pXre, const float* pXim, const float* pHre, const float* pHim, double* pAccre, double* pAccim, unsigned int pBins)
+{
+	unsigned int k = 0;
+	
+#if defined(__AVX__)
+	for(; k + 4 <= pBins; k += 4)
+	{
+		__m256d xre = _mm256_cvtps_pd(_mm_loadu_ps(pXre + k));
+		__m256d xim = _mm256_cvtps_pd(_mm_loadu_ps(pXim + k));
+		__m256d hre = _mm256_cvtps_pd(_mm_loadu_ps(pHre + k));
+		__m256d him = _mm256_cvtps_pd(_mm_loadu_ps(pHim + k));
+		
+		__m256d accre = _mm256_add_pd(_mm256_loadu_pd(pAccre + k), _mm256_sub_pd(_mm256_mul_pd(xre, hre), _mm256_mul_pd(xim, him)));
+		__m256d accim = _mm256_add_pd(_mm256_loadu_pd(pAccim + k), _mm256_add_pd(_mm256_mul_pd(xre, him), _mm256_mul_pd(xim, hre)));
+		_mm256_storeu_pd(pAccre + k, accre);
+		_mm256_storeu_pd(pAccim + k, accim);
+	}
+#elif defined(__SSE2__)
+	unsigned int half;
+	for(; k + 4 <= pBins; k += 4)
+	{
+		__m128 xre4 = _mm_loadu_ps(pXre + k);
+		__m128 xim4 = _mm_loadu_ps(pXim + k);
+		__m128 hre4 = _mm_loadu_ps(pHre + k);
+		__m128 him4 = _mm_loadu_ps(pHim + k);
+		
+		for(half = 0; half < 4; half += 2)
+		{
+			__m128d xre = _mm_cvtps_pd(xre4);
+			__m128d xim = _mm_cvtps_pd(xim4);
+			__m128d hre = _mm_cvtps_pd(hre4);
+			__m128d him = _mm_cvtps_pd(him4);
+			
+			__m128d accre = _mm_add_pd(_mm_loadu_pd(pAccre + k + half), _mm_sub_pd(_mm_mul_pd(xre, hre), _mm_mul_pd(xim, him)));
+			__m128d accim = _mm_add_pd(_mm_loadu_pd(pAccim + k + half), _mm_add_pd(_mm_mul_pd(xre, him), _mm_mul_pd(xim, hre)));
+			_mm_storeu_pd(pAccre + k + half, accre);
+			_mm_storeu_pd(pAccim + k + half, accim);
+			
+			xre4 = _mm_movehl_ps(xre4, xre4);
+			xim4 = _mm_movehl_ps(xim4, xim4);
+			hre4 = _mm_movehl_ps(hre4, hre4);
+			him4 = _mm_movehl_ps(him4, him4);
+		}
+	}
+#endif
+	
+	for(; k < pBins; k++)
+	{
+		pAccre[k] += (double)pXre[k] * pHre[k] - (double)pXim[k] * pHim[k];
+		pAccim[k] += (double)pXre[k] * pHim[k] + (double)pXim[k] * pHre[k];
+	}
+}
+
+/**
+	A partition as floats, widened into pScratch if it is stored in reduced precision
+*/
+const float* tr_irspectra_partition(const tr_irspectra* pSpectra, unsigned int pPartition, float* pScratch)
+{
+	unsigned int spectrum = TR_FFT_SPECTRUM(pSpectra->blocksize * 2);
+	const uint16_t* packed = (const uint16_t*)pSpectra->spectra + pPartition * spectrum;
+	unsigned int k;
+	
+	switch(pSpectra->precision)
+	{
+	case TR_IRSPECTRA_HALF:
+		for(k = 0; k < spectrum; k++)
+		{
+			pScratch[k] = tr_half_to_float(packed[k]) * pSpectra->scale[pPartition];
+		}
+		return pScratch;
+	case TR_IRSPECTRA_BFLOAT16:
+		for(k = 0; k < spectrum; k++)
+		{
+			pScratch[k] = tr_bfloat16_to_float(packed[k]);
+		}
+		return pScratch;
+	default:
+		return (const float*)pSpectra->spectra + pPartition * spectrum;
+	}
+}
+
+int tr_irspectra_init(tr_irspectra* pSpectra, tr_fft* pFFT, const float* pResponse, unsigned int pLength, int pPrecision)
+{
+	unsigned int blocksize = pFFT->size / 2;
+	unsigned int spectrum  = TR_FFT_SPECTRUM(blocksize * 2);
+	size_t       element   = pPrecision == TR_IRSPECTRA_FLOAT ? sizeof(float) : sizeof(uint16_t);
+	
+	pSpectra->blocksize  = blocksize;
+	pSpectra->partitions = (pLength + blocksize - 1) / blocksize;
+	pSpectra->length     = pLength;
+	pSpectra->precision  = pPrecision;
+	pSpectra->spectra    = malloc(pSpectra->partitions * spectrum * element);
+	pSpectra->scale      = malloc(pSpectra->partitions * sizeof(float));
+	if(!pSpectra->spectra || !pSpectra->scale)
+	{
+		tr_irspectra_free(pSpectra);
+		return 0;
+	}
+	
+	/* Each partition sits in the first half of a zero padded transform */
+	float* padded    = calloc(blocksize * 2, sizeof(float));
+	float* transform = malloc(spectrum * sizeof(float));
+	unsigned int p;
+	for(p = 0; p < pSpectra->partitions; p++)
+	{
+		unsigned int count = pLength - p * blocksize < blocksize ? pLength - p * blocksize : blocksize;
+		memcpy(padded, pResponse + p * blocksize, count * sizeof(float));
+		memset(padded + count, 0, (blocksize * 2 - count) * sizeof(float));
+		
+		pSpectra->scale[p] = 1.0f;
+		if(pPrecision == TR_IRSPECTRA_FLOAT)
+		{
+			tr_fft_forward(pFFT, padded, (float*)pSpectra->spectra + p * spectrum);
+			continue;
+		}
+		
+		tr_fft_forward(pFFT, padded, transform);
+		uint16_t* packed = (uint16_t*)pSpectra->spectra + p * spectrum;
+		unsigned int k;
+		
+		if(pPrecision == TR_IRSPECTRA_HALF)
+		{
+			/* Power of two scale, so scaling itself adds no rounding */
+			float peak = 0.0f;
+			for(k = 0; k < spectrum; k++)
+			{
+				peak = fabsf(transform[k]) > peak ? fabsf(transform[k]) : peak;
+			}
+			int exponent = 0;
+			if(peak > 0.0f)
+			{
+				frexpf(TR_HALF_RANGE / peak, &exponent);
+				--exponent;
+			}
+			pSpectra->scale[p] = ldexpf(1.0f, -exponent);
+			
+			for(k = 0; k < spectrum; k++)
+			{
+				packed[k] = tr_float_to_half(ldexpf(transform[k], exponent));
+			}
+		}
+		else
+		{
+			for(k = 0; k < spectrum; k++)
+			{
+				packed[k] = tr_float_to_bfloat16(transform[k]);
+			}
+		}
+	}
+	free(padded);
+	free(transform);
+	
+	return 1;
+}
+
+void tr_irspectra_free(tr_irspectra* pSpectra)
+{
+	free(pSpectra->spectra);
+	free(pSpectra->scale);
+	pSpectra->spectra = NULL;
+	pSpectra->scale   = NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
@@ -0,0 +1,297 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   Real FFT built on an iterative radix-2 complex FFT of half the size.
+   See:  http://www.engineeringproductivitytools.com/stuff/T0001/PT10.HTM
+   
+   The radix 4 variant runs the same decimation in time passes two at a time
+   (radix 2^2), halving the number of sweeps over the data.
+*/
+
+#include "fft.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+static void tr_fft_butterflies(const tr_fft* pFFT, float* pData);
+static void tr_fft_butterflies4(const tr_fft* pFFT, float* pData);
+
+
+int tr_fft_init(tr_fft* pFFT, unsigned int pSize)
+{
+	if(pSize < 4 || (pSize & (pSize - 1)))
+	{
+		return 0;
+	}
+	
+	unsigned int half = pSize / 2;
+	unsigned int bits = 0;
+	while((1u << bits) < half)
+	{
+		++bits;
+	}
+	
+	pFFT->size    = pSize;
+	pFFT->radix   = 2;
+	pFFT->bitrev  = malloc(half * sizeof(unsigned int));
+	pFFT->twiddle = malloc(half * sizeof(float));
+	pFFT->split   = malloc((half + 1) * 2 * sizeof(float));
+	pFFT->work    = malloc(half * 2 * sizeof(float));
+	if(!pFFT->bitrev || !pFFT->twiddle || !pFFT->split || !pFFT->work)
+	{
+		tr_fft_free(pFFT);
+		return 0;
+	}
+	
+	unsigned int i;
+	for(i = 0; i < half; i++)
+	{
+		unsigned int rev = 0;
+		unsigned int b;
+		for(b = 0; b < bits; b++)
+		{
+			rev |= ((i >> b) & 1) << (bits - 1 - b);
+		}
+		pFFT->bitrev[i] = rev;
+	}
+	
+	for(i = 0; i < half / 2; i++)
+	{
+		pFFT->twiddle[2*i]   = cos(2.0 * M_PI * i / half);
+		pFFT->twiddle[2*i+1] = -sin(2.0 * M_PI * i / half);
+	}
+	
+	for(i = 0; i <= half; i++)
+	{
+		pFFT->split[2*i]   = cos(2.0 * M_PI * i / pSize);
+		pFFT->split[2*i+1] = -sin(2.0 * M_PI * i / pSize);
+	}
+	
+	return 1;
+}
+
+void tr_fft_free(tr_fft* pFFT)
+{
+	free(pFFT->bitrev);
+	free(pFFT->twiddle);
+	free(pFFT->split);
+	free(pFFT->work);
+}
+
+/**
+	In place decimation in time passes over size/2 bit reversed complex values
+*/
+void tr_fft_butterflies(const tr_fft* pFFT, float* pData)
+{
+	unsigned int half = pFFT->size / 2;
+	unsigned int len;
+	
+	if(pFFT->radix == 4)
+	{
+		tr_fft_butterflies4(pFFT, pData);
+		return;
+	}
+	
+	for(len = 2; len <= half; len <<= 1)
+	{
+		unsigned int step = half / len;
+		unsigned int mid  = len / 2;
+		unsigned int i;
+		
+		for(i = 0; i < half; i += len)
+		{
+			float* a = pData + 2*i;
+			float* b = pData + 2*(i + mid);
+			unsigned int j;
+			
+			for(j = 0; j < mid; j++)
+			{
+				float wr = pFFT->twiddle[2*j*step];
+				float wi = pFFT->twiddle[2*j*step+1];
+				float vr = b[2*j] * wr - b[2*j+1] * wi;
+				float vi = b[2*j] * wi + b[2*j+1] * wr;
+				
+				b[2*j]   = a[2*j]   - vr;
+				b[2*j+1] = a[2*j+1] - vi;
+				a[2*j]   += vr;
+				a[2*j+1] += vi;
+			}
+		}
+	}
+}
+
+/**
+	Two passes per sweep, the len point pass followed by the 2*len point pass
+*/
+void tr_fft_butterflies4(const tr_fft* pFFT, float* pData)
+{
+	unsigned int half = pFFT->size / 2;
+	unsigned int len  = 2;
+	unsigned int i;
+	
+	/* An odd number of passes, the first one has no twiddles so do it on its own */
+	unsigned int passes = 0;
+	while((1u << passes) < half)
+	{
+		++passes;
+	}
+	if(passes & 1)
+	{
+		for(i = 0; i < half; i += 2)
+		{
+			float* a = pData + 2*i;
+			float br = a[2];
+			float bi = a[3];
+			a[2] = a[0] - br;
+			a[3] = a[1] - bi;
+			a[0] += br;
+			a[1] += bi;
+		}
+		len = 4;
+	}
+	
+	for(; len < half; len *= 4)
+	{
+		unsigned int quarter = len / 2;
+		unsigned int step1   = half / len;
+		unsigned int step2   = half / (len * 2);
+		
+		for(i = 0; i < half; i += len * 2)
+		{
+			unsigned int j;
+			for(j = 0; j < quarter; j++)
+			{
+				float* a = pData + 2*(i + j);
+				float* b = a + 2*quarter;
+				float* c = a + 2*len;
+				float* d = c + 2*quarter;
+				
+				float w1r = pFFT->twiddle[2*j*step1];
+				float w1i = pFFT->twiddle[2*j*step1+1];
+				float w2r = pFFT->twiddle[2*j*step2];
+				float w2i = pFFT->twiddle[2*j*step2+1];
+				float w3r = pFFT->twiddle[2*(j+quarter)*step2];
+				float w3i = pFFT->twiddle[2*(j+quarter)*step2+1];
+				
+				/* len point pass over (a,b) and (c,d) */
+				float tr = b[0] * w1r - b[1] * w1i;
+				float ti = b[0] * w1i + b[1] * w1r;
+				float a1r = a[0] + tr, a1i = a[1] + ti;
+				float b1r = a[0] - tr, b1i = a[1] - ti;
+				
+				tr = d[0] * w1r - d[1] * w1i;
+				ti = d[0] * w1i + d[1] * w1r;
+				float c1r = c[0] + tr, c1i = c[1] + ti;
+				float d1r = c[0] - tr, d1i = c[1] - ti;
+				
+				/* 2*len point pass over (a,c) and (b,d) */
+				tr = c1r * w2r - c1i * w2i;
+				ti = c1r * w2i + c1i * w2r;
+				a[0] = a1r + tr;  a[1] = a1i + ti;
+				c[0] = a1r - tr;  c[1] = a1i - ti;
+				
+				tr = d1r * w3r - d1i * w3i;
+				ti = d1r * w3i + d1i * w3r;
+				b[0] = b1r + tr;  b[1] = b1i + ti;
+				d[0] = b1r - tr;  d[1] = b1i - ti;
+			}
+		}
+	}
+}
+
+void tr_fft_forward(tr_fft* pFFT, const float* pInput, float* pSpectrum)
+{
+	unsigned int half = pFFT->size / 2;
+	float* work = pFFT->work;
+	float* re   = pSpectrum;
+	float* im   = pSpectrum + half + 1;
+	
+	/* Even samples are the real part, odd samples the imaginary part */
+	unsigned int n;
+	for(n = 0; n < half; n++)
+	{
+		work[2*pFFT->bitrev[n]]   = pInput[2*n];
+		work[2*pFFT->bitrev[n]+1] = pInput[2*n+1];
+	}
+	
+	tr_fft_butterflies(pFFT, work);
+	
+	unsigned int k;
+	for(k = 0; k <= half; k++)
+	{
+		unsigned int a = k == half ? 0 : k;
+		unsigned int b = k == 0 ? 0 : half - k;
+		
+		float er = 0.5f * (work[2*a]   + work[2*b]);
+		float ei = 0.5f * (work[2*a+1] - work[2*b+1]);
+		float odr = 0.5f * (work[2*a+1] + work[2*b+1]);
+		float odi = 0.5f * (work[2*b]   - work[2*a]);
+		float wr = pFFT->split[2*k];
+		float wi = pFFT->split[2*k+1];
+		
+		re[k] = er + odr * wr - odi * wi;
+		im[k] = ei + odr * wi + odi * wr;
+	}
+}
+
+void tr_fft_inverse(tr_fft* pFFT, const float* pSpectrum, float* pOutput)
+{
+	unsigned int half = pFFT->size / 2;
+	float* work     = pFFT->work;
+	const float* re = pSpectrum;
+	const float* im = pSpectrum + half + 1;
+	
+	/* Rebuild the half size complex spectrum, conjugated so the forward passes invert it */
+	unsigned int k;
+	for(k = 0; k < half; k++)
+	{
+		float er = 0.5f * (re[k] + re[half - k]);
+		float ei = 0.5f * (im[k] - im[half - k]);
+		float dr = 0.5f * (re[k] - re[half - k]);
+		float di = 0.5f * (im[k] + im[half - k]);
+		float wr = pFFT->split[2*k];
+		float wi = -pFFT->split[2*k+1];
+		float odr = dr * wr - di * wi;
+		float odi = dr * wi + di * wr;
+		
+		work[2*pFFT->bitrev[k]]   = er - odi;
+		work[2*pFFT->bitrev[k]+1] = -(ei + odr);
+	}
+	
+	tr_fft_butterflies(pFFT, work);
+	
+	const float scale = 1.0f / half;
+	unsigned int n;
+	for(n = 0; n < half; n++)
+	{
+		pOutput[2*n]   = work[2*n] * scale;
+		pOutput[2*n+1] = -work[2*n+1] * scale;
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
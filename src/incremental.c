@@ -0,0 +1,279 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "incremental.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+static char* tr_incremental_planname(const char* pOutputName);
+static int tr_span_compare(const void* pA, const void* pB);
+
+
+void tr_spans_init(tr_spans* pSpans)
+{
+	pSpans->count    = 0;
+	pSpans->capacity = 0;
+	pSpans->spans    = NULL;
+}
+
+void tr_spans_free(tr_spans* pSpans)
+{
+	free(pSpans->spans);
+	tr_spans_init(pSpans);
+}
+
+void tr_spans_add(tr_spans* pSpans, unsigned int pStart, unsigned int pEnd)
+{
+	if(pStart >= pEnd)
+	{
+		return;
+	}
+	
+	if(pSpans->count == pSpans->capacity)
+	{
+		pSpans->capacity = pSpans->capacity ? pSpans->capacity * 2 : 16;
+		pSpans->spans    = realloc(pSpans->spans, pSpans->capacity * sizeof(tr_span));
+	}
+	pSpans->spans[pSpans->count].start = pStart;
+	pSpans->spans[pSpans->count].end   = pEnd;
+	++pSpans->count;
+	
+	/* Spans mostly arrive in order, keep it simple and sort then merge */
+	qsort(pSpans->spans, pSpans->count, sizeof(tr_span), tr_span_compare);
+	
+	unsigned int i, merged = 0;
+	for(i = 1; i < pSpans->count; i++)
+	{
+		if(pSpans->spans[i].start <= pSpans->spans[merged].end)
+		{
+			if(pSpans->spans[i].end > pSpans->spans[merged].end)
+			{
+				pSpans->spans[merged].end = pSpans->spans[i].end;
+			}
+		}
+		else
+		{
+			pSpans->spans[++merged] = pSpans->spans[i];
+		}
+	}
+	pSpans->count = merged + 1;
+}
+
+int tr_spans_overlap(const tr_spans* pSpans, unsigned int pStart, unsigned int pEnd)
+{
+	unsigned int i;
+	for(i = 0; i < pSpans->count; i++)
+	{
+		if(pSpans->spans[i].start < pEnd && pStart < pSpans->spans[i].end)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int tr_incremental_diff(tr_wavfile* pOld, tr_wavfile* pNew, unsigned int pBlockFrames, tr_spans* pChanged)
+{
+	unsigned int channels = pNew->channels;
+	unsigned int frames   = pNew->totalsamples / channels;
+	float* oldblock = malloc(pBlockFrames * channels * sizeof(float));
+	float* newblock = malloc(pBlockFrames * channels * sizeof(float));
+	int ok = 1;
+	
+	tr_wavseek(pOld, 0);
+	tr_wavseek(pNew, 0);
+	
+	unsigned int pos;
+	for(pos = 0; pos < frames; pos += pBlockFrames)
+	{
+		unsigned int count = frames - pos < pBlockFrames ? frames - pos : pBlockFrames;
+		if( !tr_wavread(pOld, oldblock, count * channels) || !tr_wavread(pNew, newblock, count * channels) )
+		{
+			ok = 0;
+			break;
+		}
+		
+		if(tr_incremental_hash(oldblock, count * channels) != tr_incremental_hash(newblock, count * channels))
+		{
+			tr_spans_add(pChanged, pos, pos + count);
+		}
+	}
+	
+	free(oldblock);
+	free(newblock);
+	return ok;
+}
+
+void tr_incremental_affected(const tr_spans* pChanged, unsigned int pResponseFrames, unsigned int pBlockSize,
+                             unsigned int pTotalFrames, tr_spans* pAffected)
+{
+	unsigned int i;
+	for(i = 0; i < pChanged->count; i++)
+	{
+		unsigned int start = pChanged->spans[i].start / pBlockSize * pBlockSize;
+		unsigned long long end = (unsigned long long)pChanged->spans[i].end + pResponseFrames - 1;
+		end = (end + pBlockSize - 1) / pBlockSize * pBlockSize;
+		
+		tr_spans_add(pAffected, start, end < pTotalFrames ? (unsigned int)end : pTotalFrames);
+	}
+}
+
+/**
+	Output block t needs the spectra of the last partitions input blocks, and each of
+	those is transformed with the block before it.  Pushing that many blocks ahead of
+	pStart refills the delay line exactly; the slots are summed in the same order
+	whatever their position, so the result is bit identical.
+*/
+int tr_incremental_render(tr_stream* pStream, tr_wavfile* pInput, unsigned int pInputFrames,
+                          unsigned int pStart, unsigned int pEnd, float* pOutput)
+{
+	unsigned int channels  = pStream->channels;
+	unsigned int blocksize = pStream->blocksize;
+	unsigned int warmup    = pStream->convolvers[0].partitions * blocksize;
+	unsigned int pos       = pStart > warmup ? pStart - warmup : 0;
+	
+	float* inblock  = malloc(blocksize * channels * sizeof(float));
+	float* outblock = malloc(blocksize * channels * sizeof(float));
+	int ok = 1;
+	
+	tr_stream_reset(pStream);
+	tr_wavseek(pInput, pos * channels);
+	
+	for(; pos < pEnd; pos += blocksize)
+	{
+		unsigned int count = pos < pInputFrames ? pInputFrames - pos : 0;
+		if(count > blocksize)
+		{
+			count = blocksize;
+		}
+		if(count > 0 && !tr_wavread(pInput, inblock, count * channels))
+		{
+			ok = 0;
+			break;
+		}
+		memset(inblock + count * channels, 0, (blocksize - count) * channels * sizeof(float));
+		
+		/* Blocks ahead of the span only fill the delay lines */
+		if(pos < pStart)
+		{
+			tr_stream_push(pStream, inblock);
+			continue;
+		}
+		tr_stream_process(pStream, inblock, outblock);
+		
+		unsigned int keep = pEnd - pos < blocksize ? pEnd - pos : blocksize;
+		memcpy(pOutput + (pos - pStart) * channels, outblock, keep * channels * sizeof(float));
+	}
+	
+	free(inblock);
+	free(outblock);
+	return ok;
+}
+
+/* FNV-1a over whole samples */
+uint64_t tr_incremental_hash(const float* pData, unsigned int pCount)
+{
+	uint64_t hash = 14695981039346656037ull;
+	uint32_t word;
+	
+	while(pCount-- > 0)
+	{
+		memcpy(&word, pData++, sizeof(uint32_t));
+		hash ^= word;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+char* tr_incremental_planname(const char* pOutputName)
+{
+	char* planname = malloc(strlen(pOutputName) + 6);
+	strcpy(planname, pOutputName);
+	strcat(planname, ".plan");
+	return planname;
+}
+
+int tr_incremental_saveplan(const char* pOutputName, const tr_incremental_plan* pPlan)
+{
+	char* planname = tr_incremental_planname(pOutputName);
+	FILE* file = fopen(planname, "w");
+	free(planname);
+	if(file == 0)
+	{
+		return 0;
+	}
+	
+	fprintf(file, "# trillian render plan: blocksize, radix, precision, double, response hash\n");
+	fprintf(file, "%u\t%u\t%d\t%d\t%016llx\n", pPlan->blocksize, pPlan->radix, pPlan->precision, pPlan->doubleaccum,
+	   (unsigned long long)pPlan->response);
+	return fclose(file) == 0;
+}
+
+int tr_incremental_loadplan(const char* pOutputName, tr_incremental_plan* pPlan)
+{
+	char* planname = tr_incremental_planname(pOutputName);
+	FILE* file = fopen(planname, "r");
+	free(planname);
+	if(file == 0)
+	{
+		return 0;
+	}
+	
+	char line[256];
+	int found = 0;
+	while(!found && fgets(line, sizeof(line), file))
+	{
+		unsigned long long response;
+		if(line[0] != '#' && sscanf(line, "%u\t%u\t%d\t%d\t%llx", &pPlan->blocksize, &pPlan->radix, &pPlan->precision,
+		   &pPlan->doubleaccum, &response) == 5)
+		{
+			pPlan->response = response;
+			found = 1;
+		}
+	}
+	
+	fclose(file);
+	return found;
+}
+
+void tr_incremental_removeplan(const char* pOutputName)
+{
+	char* planname = tr_incremental_planname(pOutputName);
+	remove(planname);
+	free(planname);
+}
+
+int tr_span_compare(const void* pA, const void* pB)
+{
+	const tr_span* a = pA;
+	const tr_span* b = pB;
+	return a->start < b->start ? -1 : a->start > b->start ? 1 : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
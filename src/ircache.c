@@ -0,0 +1,152 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ircache.h"
+#include "convolve.h"
+#include "wavfile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+static tr_ircache_entry* tr_ircache_load(tr_ircache* pCache, const char* pFilename);
+
+
+int tr_ircache_init(tr_ircache* pCache, unsigned int pBlockSize, int pPrecision)
+{
+	pCache->entries   = NULL;
+	pCache->precision = pPrecision;
+	return tr_fft_init(&pCache->fft, pBlockSize * 2);
+}
+
+void tr_ircache_free(tr_ircache* pCache)
+{
+	while(pCache->entries)
+	{
+		tr_ircache_entry* entry = pCache->entries;
+		pCache->entries = entry->next;
+		
+		unsigned int c;
+		for(c = 0; c < entry->channels; c++)
+		{
+			tr_irspectra_free(&entry->spectra[c]);
+		}
+		free(entry->spectra);
+		free(entry->filename);
+		free(entry);
+	}
+	tr_fft_free(&pCache->fft);
+}
+
+const tr_ircache_entry* tr_ircache_get(tr_ircache* pCache, const char* pFilename)
+{
+	tr_ircache_entry* entry;
+	for(entry = pCache->entries; entry; entry = entry->next)
+	{
+		if(strcmp(entry->filename, pFilename) == 0)
+		{
+			return entry;
+		}
+	}
+	
+	entry = tr_ircache_load(pCache, pFilename);
+	if(entry)
+	{
+		entry->next = pCache->entries;
+		pCache->entries = entry;
+	}
+	return entry;
+}
+
+tr_ircache_entry* tr_ircache_load(tr_ircache* pCache, const char* pFilename)
+{
+	FILE* file = fopen(pFilename, "rb");
+	if(file == 0)
+	{
+		return NULL;
+	}
+	
+	tr_wavfile wav;
+	if( !tr_wavopen(file, &wav, 'r') )
+	{
+		fclose(file);
+		return NULL;
+	}
+	
+	float* buffer = malloc(wav.totalsamples * sizeof(float));
+	if( !buffer || !tr_wavread(&wav, buffer, wav.totalsamples) )
+	{
+		free(buffer);
+		tr_wavclose(&wav);
+		fclose(file);
+		return NULL;
+	}
+	
+	tr_ircache_entry* entry = calloc(1, sizeof(tr_ircache_entry));
+	float* channel = malloc(wav.totalsamples / wav.channels * sizeof(float));
+	if(entry)
+	{
+		entry->filename   = strdup(pFilename);
+		entry->channels   = wav.channels;
+		entry->samplerate = wav.samplerate;
+		entry->frames     = wav.totalsamples / wav.channels;
+		entry->spectra    = malloc(wav.channels * sizeof(tr_irspectra));
+		entry->next       = NULL;
+	}
+	
+	unsigned int c;
+	for(c = 0; entry && entry->filename && entry->spectra && channel && c < entry->channels; c++)
+	{
+		tr_deinterleave(buffer, channel, entry->channels, c, entry->frames);
+		if( !tr_irspectra_init(&entry->spectra[c], &pCache->fft, channel, entry->frames, pCache->precision) )
+		{
+			break;
+		}
+	}
+	
+	/* Out of memory part way, the channels done so far go with the entry */
+	if(entry && c < entry->channels)
+	{
+		while(c-- > 0)
+		{
+			tr_irspectra_free(&entry->spectra[c]);
+		}
+		free(entry->spectra);
+		free(entry->filename);
+		free(entry);
+		entry = NULL;
+	}
+	
+	free(channel);
+	free(buffer);
+	tr_wavclose(&wav);
+	fclose(file);
+	
+	return entry;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
@@ -0,0 +1,268 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "multirate.h"
+#include "convolve.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+static void tr_multirate_lowpass(float* pTaps, unsigned int pLength, unsigned int pFactor);
+static void tr_multirate_split(const float* pResponse, unsigned int pReLen, unsigned int pCrossover, float* pEarly, float* pLate);
+static void tr_multirate_decimate(const float* pSource, unsigned int pLength, const float* pTaps, unsigned int pNumTaps, unsigned int pFactor, float pGain, float* pDest);
+static void tr_multirate_interpolate(const float* pSource, unsigned int pLength, const float* pTaps, unsigned int pNumTaps, unsigned int pFactor, unsigned int pDelay, float* pDest, unsigned int pDestLen);
+static void tr_multirate_late(unsigned int pFactor, const float* pInput, unsigned int pInLen, const float* pLate, unsigned int pLateLen, float* pOutput, int pDouble);
+
+/* The crossover is kept on a multiple of every factor we might pick */
+#define TR_MULTIRATE_ALIGN(pos)  ((pos) - (pos) % TR_MULTIRATE_MAX_FACTOR)
+
+
+/**
+	Blackman windowed sinc, cut off just below the Nyquist of the decimated rate
+*/
+void tr_multirate_lowpass(float* pTaps, unsigned int pLength, unsigned int pFactor)
+{
+	const double cutoff = 0.45 / pFactor;
+	const double centre = (pLength - 1) * 0.5;
+	double sum = 0.0;
+	
+	unsigned int i;
+	for(i = 0; i < pLength; i++)
+	{
+		double t = i - centre;
+		double sinc = t == 0.0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+		double window = 0.42 - 0.5 * cos(2.0 * M_PI * i / (pLength - 1)) + 0.08 * cos(4.0 * M_PI * i / (pLength - 1));
+		
+		pTaps[i] = sinc * window;
+		sum += pTaps[i];
+	}
+	
+	for(i = 0; i < pLength; i++)
+	{
+		pTaps[i] /= sum;
+	}
+}
+
+/**
+	Raised cosine crossover, pEarly holds pCrossover + TR_MULTIRATE_FADE samples
+	and pLate holds pReLen - pCrossover samples.  pEarly may be NULL when only the
+	late part is wanted.
+*/
+void tr_multirate_split(const float* pResponse, unsigned int pReLen, unsigned int pCrossover, float* pEarly, float* pLate)
+{
+	if(pEarly)
+	{
+		memcpy(pEarly, pResponse, pCrossover * sizeof(float));
+	}
+	memcpy(pLate, pResponse + pCrossover, (pReLen - pCrossover) * sizeof(float));
+	
+	unsigned int i;
+	for(i = 0; i < TR_MULTIRATE_FADE; i++)
+	{
+		float fade = 0.5 - 0.5 * cos(M_PI * (i + 0.5) / TR_MULTIRATE_FADE);
+		if(pEarly)
+		{
+			pEarly[pCrossover + i] = pResponse[pCrossover + i] * (1.0f - fade);
+		}
+		pLate[i] *= fade;
+	}
+}
+
+/**
+	pDest[m] = pGain * (taps * source)[m * pFactor], pDest must hold
+	(pLength + pNumTaps - 1 + pFactor - 1) / pFactor samples
+*/
+void tr_multirate_decimate(const float* pSource, unsigned int pLength, const float* pTaps, unsigned int pNumTaps, unsigned int pFactor, float pGain, float* pDest)
+{
+	unsigned int destlen = (pLength + pNumTaps - 1 + pFactor - 1) / pFactor;
+	
+	unsigned int m;
+	for(m = 0; m < destlen; m++)
+	{
+		unsigned int pos  = m * pFactor;
+		unsigned int t_lo = pos < pLength ? 0 : pos - pLength + 1;
+		unsigned int t_hi = pos + 1 < pNumTaps ? pos + 1 : pNumTaps;
+		
+		float sum = 0.0f;
+		unsigned int t;
+		for(t = t_lo; t < t_hi; t++)
+		{
+			sum += pTaps[t] * pSource[pos - t];
+		}
+		*pDest++ = sum * pGain;
+	}
+}
+
+/**
+	Zero stuff and filter, adding into pDest.  pDelay samples of the interpolated
+	signal are skipped to compensate for the filter delays.
+*/
+void tr_multirate_interpolate(const float* pSource, unsigned int pLength, const float* pTaps, unsigned int pNumTaps, unsigned int pFactor, unsigned int pDelay, float* pDest, unsigned int pDestLen)
+{
+	unsigned int n;
+	for(n = 0; n < pDestLen; n++)
+	{
+		unsigned int j    = n + pDelay;
+		unsigned int m_lo = j < pNumTaps ? 0 : (j - pNumTaps + pFactor) / pFactor;
+		unsigned int m_hi = j / pFactor + 1 < pLength ? j / pFactor + 1 : pLength;
+		
+		float sum = 0.0f;
+		unsigned int m;
+		for(m = m_lo; m < m_hi; m++)
+		{
+			sum += pSource[m] * pTaps[j - m * pFactor];
+		}
+		*pDest++ += sum * pFactor;
+	}
+}
+
+/**
+	Late path, adds pInLen + pLateLen - 1 samples into pOutput
+*/
+void tr_multirate_late(unsigned int pFactor, const float* pInput, unsigned int pInLen, const float* pLate, unsigned int pLateLen, float* pOutput, int pDouble)
+{
+	unsigned int numtaps = TR_MULTIRATE_TAPS * pFactor + 1;
+	unsigned int delay   = 3 * (numtaps - 1) / 2;
+	unsigned int inlen   = (pInLen + numtaps - 1 + pFactor - 1) / pFactor;
+	unsigned int relen   = (pLateLen + numtaps - 1 + pFactor - 1) / pFactor;
+	
+	float* taps     = malloc(numtaps * sizeof(float));
+	float* input    = malloc(inlen * sizeof(float));
+	float* response = malloc(relen * sizeof(float));
+	float* output   = malloc((inlen + relen - 1) * sizeof(float));
+	
+	tr_multirate_lowpass(taps, numtaps, pFactor);
+	tr_multirate_decimate(pInput, pInLen, taps, numtaps, pFactor, 1.0f, input);
+	tr_multirate_decimate(pLate, pLateLen, taps, numtaps, pFactor, pFactor, response);
+	
+	if(pDouble)
+	{
+		tr_convolve_direct_double(input, inlen, response, relen, output);
+	}
+	else
+	{
+		tr_convolve_direct(input, inlen, response, relen, output);
+	}
+	
+	tr_multirate_interpolate(output, inlen + relen - 1, taps, numtaps, pFactor, delay, pOutput, pInLen + pLateLen - 1);
+	
+	free(taps);
+	free(input);
+	free(response);
+	free(output);
+}
+
+
+void tr_multirate_plan(tr_multirate* pPlan, const float* pResponse, unsigned int pReLen, unsigned int pCrossover, float pMaxError)
+{
+	pPlan->factor    = 1;
+	pPlan->crossover = TR_MULTIRATE_ALIGN(pCrossover);
+	pPlan->error     = -INFINITY;
+	pPlan->doubleaccum = 0;
+	
+	if(pPlan->crossover + TR_MULTIRATE_FADE >= pReLen)
+	{
+		return; /* Nothing worth decimating */
+	}
+	
+	unsigned int latelen = pReLen - pPlan->crossover;
+	float* late  = malloc(latelen * sizeof(float));
+	float* check = malloc(latelen * sizeof(float));
+	tr_multirate_split(pResponse, pReLen, pPlan->crossover, NULL, late);
+	
+	double energy = 0.0;
+	unsigned int i;
+	for(i = 0; i < pReLen; i++)
+	{
+		energy += (double)pResponse[i] * pResponse[i];
+	}
+	
+	/* Run an impulse through the late path and compare it against the true late response */
+	const float impulse = 1.0f;
+	unsigned int factor;
+	for(factor = TR_MULTIRATE_MAX_FACTOR; factor > 1; factor /= 2)
+	{
+		memset(check, 0, latelen * sizeof(float));
+		tr_multirate_late(factor, &impulse, 1, late, latelen, check, 0);
+		
+		double error = 0.0;
+		for(i = 0; i < latelen; i++)
+		{
+			error += ((double)check[i] - late[i]) * ((double)check[i] - late[i]);
+		}
+		
+		pPlan->error = energy > 0.0 ? 10.0 * log10(error / energy) : -INFINITY;
+		if(pPlan->error <= pMaxError)
+		{
+			pPlan->factor = factor;
+			break;
+		}
+	}
+	
+	free(late);
+	free(check);
+}
+
+void tr_multirate_convolve(const tr_multirate* pPlan, const float* pInput, unsigned int pInLen, const float* pResponse, unsigned int pReLen, float* pOutput)
+{
+	if(pPlan->factor == 1)
+	{
+		if(pPlan->doubleaccum)
+		{
+			tr_convolve_direct_double(pInput, pInLen, pResponse, pReLen, pOutput);
+		}
+		else
+		{
+			tr_convolve_direct(pInput, pInLen, pResponse, pReLen, pOutput);
+		}
+		return;
+	}
+	
+	unsigned int earlylen = pPlan->crossover + TR_MULTIRATE_FADE;
+	unsigned int latelen  = pReLen - pPlan->crossover;
+	float* early = malloc(earlylen * sizeof(float));
+	float* late  = malloc(latelen * sizeof(float));
+	tr_multirate_split(pResponse, pReLen, pPlan->crossover, early, late);
+	
+	/* Early part writes the head of the output, the late part is added on top from the crossover */
+	if(pPlan->doubleaccum)
+	{
+		tr_convolve_direct_double(pInput, pInLen, early, earlylen, pOutput);
+	}
+	else
+	{
+		tr_convolve_direct(pInput, pInLen, early, earlylen, pOutput);
+	}
+	memset(pOutput + pInLen + earlylen - 1, 0, (pReLen - earlylen) * sizeof(float));
+	tr_multirate_late(pPlan->factor, pInput, pInLen, late, latelen, pOutput + pPlan->crossover, pPlan->doubleaccum);
+	
+	free(early);
+	free(late);
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
@@ -0,0 +1,380 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "planner.h"
+#include "convolver.h"
+#include "timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+	#include <cpuid.h>
+#endif
+
+#ifdef _WIN32
+	#include <process.h>
+	#define getpid _getpid
+#else
+	#include <unistd.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define TR_PLANNER_MIN_BLOCK  64
+#define TR_PLANNER_MAX_BLOCK  8192
+#define TR_PLANNER_SAMPLES    32768  /* per channel and candidate */
+
+static void   tr_planner_cpumodel(char* pModel, size_t pSize);
+static void   tr_planner_wisdompath(const char* pWisdom, char* pPath, size_t pSize);
+static int    tr_planner_lookup(const char* pPath, const char* pModel, unsigned int pBucket, unsigned int pChannels, tr_plan* pPlan);
+static void   tr_planner_store(const char* pPath, const char* pModel, unsigned int pBucket, unsigned int pChannels, const tr_plan* pPlan);
+static double tr_planner_time(unsigned int pLength, unsigned int pChannels, unsigned int pBlockSize, unsigned int pRadix, unsigned int pRepeats);
+
+
+void tr_planner_cpumodel(char* pModel, size_t pSize)
+{
+	strncpy(pModel, "unknown", pSize);
+	
+#if defined(__i386__) || defined(__x86_64__)
+	unsigned int brand[12];
+	if(__get_cpuid(0x80000000, &brand[0], &brand[1], &brand[2], &brand[3]) && brand[0] >= 0x80000004)
+	{
+		unsigned int i;
+		for(i = 0; i < 3; i++)
+		{
+			__get_cpuid(0x80000002 + i, &brand[4*i], &brand[4*i+1], &brand[4*i+2], &brand[4*i+3]);
+		}
+		snprintf(pModel, pSize, "%.48s", (const char*)brand);
+	}
+#else
+	FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
+	if(cpuinfo)
+	{
+		char line[256];
+		while(fgets(line, sizeof(line), cpuinfo))
+		{
+			char* colon = strchr(line, ':');
+			if(colon && (strncmp(line, "model name", 10) == 0 || strncmp(line, "cpu model", 9) == 0))
+			{
+				snprintf(pModel, pSize, "%s", colon + 1 + strspn(colon + 1, " \t"));
+				break;
+			}
+		}
+		fclose(cpuinfo);
+	}
+#endif
+	
+	/* Tabs and newlines would break the wisdom file */
+	char* c;
+	for(c = pModel; *c; c++)
+	{
+		if(*c == '\t' || *c == '\n' || *c == '\r')
+		{
+			*c = ' ';
+		}
+	}
+	while(c > pModel && c[-1] == ' ')
+	{
+		*--c = '\0';
+	}
+}
+
+void tr_planner_wisdompath(const char* pWisdom, char* pPath, size_t pSize)
+{
+	const char* home = getenv("HOME");
+	if(!home)
+	{
+		home = getenv("APPDATA");
+	}
+	
+	if(pWisdom)
+	{
+		snprintf(pPath, pSize, "%s", pWisdom);
+	}
+	else if(home)
+	{
+		snprintf(pPath, pSize, "%s/.trillian_wisdom", home);
+	}
+	else
+	{
+		snprintf(pPath, pSize, "trillian.wisdom");
+	}
+}
+
+int tr_planner_lookup(const char* pPath, const char* pModel, unsigned int pBucket, unsigned int pChannels, tr_plan* pPlan)
+{
+	FILE* file = fopen(pPath, "r");
+	if(file == 0)
+	{
+		return 0;
+	}
+	
+	char line[512];
+	int found = 0;
+	while(!found && fgets(line, sizeof(line), file))
+	{
+		char* tab = strchr(line, '\t');
+		unsigned int bucket, channels, blocksize, radix;
+		
+		if(line[0] == '#' || !tab || (size_t)(tab - line) != strlen(pModel) || strncmp(line, pModel, tab - line) != 0)
+		{
+			continue;
+		}
+		if(sscanf(tab + 1, "%u\t%u\t%u\t%u", &bucket, &channels, &blocksize, &radix) != 4 ||
+		   bucket != pBucket || channels != pChannels)
+		{
+			continue;
+		}
+		
+		/* The file can be edited by hand, only plans the measurement could have made are taken */
+		if(blocksize >= TR_PLANNER_MIN_BLOCK && blocksize <= TR_PLANNER_MAX_BLOCK && (blocksize & (blocksize - 1)) == 0 &&
+		   (radix == 2 || radix == 4))
+		{
+			pPlan->blocksize = blocksize;
+			pPlan->radix     = radix;
+			pPlan->measured  = 2;
+			found = 1;
+		}
+	}
+	
+	fclose(file);
+	return found;
+}
+
+/**
+	Rewrites the file with this plan replacing any older one for the same key.  The new
+	file is written under a name of this process and renamed over the old one, so a run
+	storing at the same time can lose its plan but never truncate the file.
+*/
+void tr_planner_store(const char* pPath, const char* pModel, unsigned int pBucket, unsigned int pChannels, const tr_plan* pPlan)
+{
+	char   key[320];
+	size_t keylen = snprintf(key, sizeof(key), "%s\t%u\t%u\t", pModel, pBucket, pChannels);
+	
+	char*  kept = NULL;
+	size_t keptlen = 0;
+	
+	FILE* file = fopen(pPath, "r");
+	if(file)
+	{
+		char line[512];
+		while(fgets(line, sizeof(line), file))
+		{
+			if(strncmp(line, key, keylen) == 0 || line[0] == '#')
+			{
+				continue;
+			}
+			size_t len = strlen(line);
+			char* grown = realloc(kept, keptlen + len + 1);
+			if(!grown)
+			{
+				/* Rewriting with only some of the old plans would lose the rest */
+				free(kept);
+				fclose(file);
+				return;
+			}
+			kept = grown;
+			memcpy(kept + keptlen, line, len + 1);
+			keptlen += len;
+		}
+		fclose(file);
+	}
+	
+	char tempname[1100];
+	snprintf(tempname, sizeof(tempname), "%s.%ld.tmp", pPath, (long)getpid());
+	
+	file = fopen(tempname, "w");
+	if(file)
+	{
+		fprintf(file, "# trillian wisdom: cpu, response length bucket, channels, blocksize, radix\n");
+		if(kept)
+		{
+			fputs(kept, file);
+		}
+		fprintf(file, "%s%u\t%u\n", key, pPlan->blocksize, pPlan->radix);
+		
+		int ok = !ferror(file);
+		ok = fclose(file) == 0 && ok;
+		if(ok)
+		{
+#ifdef _WIN32
+			remove(pPath); /* rename will not replace an existing file */
+#endif
+			ok = rename(tempname, pPath) == 0;
+		}
+		if(!ok)
+		{
+			remove(tempname);
+		}
+	}
+	free(kept);
+}
+
+/**
+	Seconds per output sample of one candidate, best of pRepeats
+*/
+double tr_planner_time(unsigned int pLength, unsigned int pChannels, unsigned int pBlockSize, unsigned int pRadix, unsigned int pRepeats)
+{
+	unsigned int partitions = (pLength + pBlockSize - 1) / pBlockSize;
+	unsigned int blocks     = TR_PLANNER_SAMPLES / pBlockSize > 4 ? TR_PLANNER_SAMPLES / pBlockSize : 4;
+	
+	float* response = malloc(pLength * sizeof(float));
+	float* block    = malloc(pBlockSize * sizeof(float));
+	float* output   = malloc(pBlockSize * sizeof(float));
+	tr_convolver* convolvers = malloc(pChannels * sizeof(tr_convolver));
+	tr_irspectra* spectra    = malloc(pChannels * sizeof(tr_irspectra));
+	
+	/* A candidate that can not be set up is never the best */
+	double best = 1e30;
+	if(!response || !block || !output || !convolvers || !spectra)
+	{
+		free(convolvers);
+		free(spectra);
+		free(response);
+		free(block);
+		free(output);
+		return best;
+	}
+	
+	unsigned int i;
+	srand(1);
+	for(i = 0; i < pLength; i++)
+	{
+		response[i] = rand() / (float)RAND_MAX - 0.5f;
+	}
+	for(i = 0; i < pBlockSize; i++)
+	{
+		block[i] = rand() / (float)RAND_MAX - 0.5f;
+	}
+	
+	/* Channels run round robin, like the block engines do */
+	unsigned int c;
+	for(c = 0; c < pChannels; c++)
+	{
+		if( !tr_convolver_init(&convolvers[c], pBlockSize, partitions) )
+		{
+			break;
+		}
+		convolvers[c].fft.radix = pRadix;
+		if( !tr_irspectra_init(&spectra[c], &convolvers[c].fft, response, pLength, TR_IRSPECTRA_FLOAT) )
+		{
+			tr_convolver_free(&convolvers[c]);
+			break;
+		}
+	}
+	
+	unsigned int r;
+	for(r = 0; r < pRepeats && c == pChannels; r++)
+	{
+		double start = 0.0;
+		unsigned int b;
+		for(b = 0; b <= blocks; b++)
+		{
+			if(b == 1)
+			{
+				start = tr_timer_seconds(); /* first block warms the caches */
+			}
+			for(c = 0; c < pChannels; c++)
+			{
+				tr_convolver_push(&convolvers[c], block);
+				tr_convolver_pull(&convolvers[c], &spectra[c], output);
+			}
+		}
+		double elapsed = (tr_timer_seconds() - start) / ((double)blocks * pBlockSize * pChannels);
+		best = elapsed < best ? elapsed : best;
+	}
+	
+	while(c-- > 0)
+	{
+		tr_irspectra_free(&spectra[c]);
+		tr_convolver_free(&convolvers[c]);
+	}
+	free(convolvers);
+	free(spectra);
+	free(response);
+	free(block);
+	free(output);
+	
+	return best;
+}
+
+void tr_planner_plan(tr_plan* pPlan, unsigned int pLength, unsigned int pChannels, int pMode, const char* pWisdom)
+{
+	char model[128];
+	char path[1024];
+	tr_planner_cpumodel(model, sizeof(model));
+	tr_planner_wisdompath(pWisdom, path, sizeof(path));
+	
+	/* Plans carry over between responses of similar length */
+	unsigned int bucket = 1;
+	while(bucket < pLength)
+	{
+		bucket *= 2;
+	}
+	
+	pPlan->blocksize = tr_convolver_blocksize(pLength);
+	pPlan->radix     = 4;
+	pPlan->measured  = 0;
+	
+	if(pMode == TR_PLAN_ESTIMATE)
+	{
+		tr_planner_lookup(path, model, bucket, pChannels, pPlan);
+		return;
+	}
+	
+	unsigned int lo      = TR_PLANNER_MIN_BLOCK;
+	unsigned int hi      = TR_PLANNER_MAX_BLOCK;
+	unsigned int repeats = 3;
+	if(pMode == TR_PLAN_MEASURE)
+	{
+		lo = pPlan->blocksize / 4 > lo ? pPlan->blocksize / 4 : lo;
+		hi = pPlan->blocksize * 4 < hi ? pPlan->blocksize * 4 : hi;
+		repeats = 1;
+	}
+	
+	double best = 1e30;
+	unsigned int blocksize;
+	for(blocksize = lo; blocksize <= hi; blocksize *= 2)
+	{
+		unsigned int radix;
+		for(radix = 2; radix <= 4; radix += 2)
+		{
+			double seconds = tr_planner_time(pLength, pChannels, blocksize, radix, repeats);
+			if(seconds < best)
+			{
+				best = seconds;
+				pPlan->blocksize = blocksize;
+				pPlan->radix     = radix;
+			}
+		}
+	}
+	
+	pPlan->measured = 1;
+	tr_planner_store(path, model, bucket, pChannels, pPlan);
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
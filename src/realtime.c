@@ -0,0 +1,91 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "realtime.h"
+#include "timer.h"
+
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+
+/**
+	The sample clock advances a block per callback.  Blocks are not paced to the wall
+	clock, each one is simply timed from the moment its input is available, which is
+	when a device would call back.
+*/
+void tr_realtime_simulate(tr_stream* pStream, const float* pInput, unsigned int pInputFrames,
+                          float* pOutput, unsigned int pOutputFrames, float* pScratch,
+                          unsigned int pSampleRate, tr_realtime_stats* pStats)
+{
+	unsigned int channels  = pStream->channels;
+	unsigned int blocksize = pStream->blocksize;
+	
+	memset(pStats, 0, sizeof(tr_realtime_stats));
+	pStats->deadline = (double)blocksize / pSampleRate;
+	
+	unsigned int clock;
+	for(clock = 0; clock < pOutputFrames; clock += blocksize)
+	{
+		/* Whole blocks are used in place, the ends go through pScratch */
+		const float* in = pInput + (size_t)clock * channels;
+		if(clock + blocksize > pInputFrames)
+		{
+			unsigned int count = clock < pInputFrames ? pInputFrames - clock : 0;
+			memcpy(pScratch, in, count * channels * sizeof(float));
+			memset(pScratch + count * channels, 0, (blocksize - count) * channels * sizeof(float));
+			in = pScratch;
+		}
+		/* In place is fine, each channel is read out before it is written back */
+		float* out = clock + blocksize > pOutputFrames ? pScratch : pOutput + (size_t)clock * channels;
+		
+		double start = tr_timer_seconds();
+		tr_stream_process(pStream, in, out);
+		double elapsed = tr_timer_seconds() - start;
+		
+		if(out == pScratch)
+		{
+			memcpy(pOutput + (size_t)clock * channels, pScratch, (pOutputFrames - clock) * channels * sizeof(float));
+		}
+		
+		double load = elapsed / pStats->deadline;
+		unsigned int bin = load < 1.0 ? (unsigned int)(load * 10.0) : load < 2.0 ? 10 : 11;
+		++pStats->histogram[bin];
+		
+		if(elapsed > pStats->deadline)
+		{
+			++pStats->xruns;
+		}
+		if(elapsed > pStats->worst)
+		{
+			pStats->worst      = elapsed;
+			pStats->worstblock = pStats->blocks;
+		}
+		pStats->total += elapsed;
+		++pStats->blocks;
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
@@ -0,0 +1,205 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "shard.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define TR_SHARD_MAGIC    0x54525348  /* 'TRSH' */
+#define TR_SHARD_VERSION  2
+
+/* Frames normalised and written per step of the merge */
+#define TR_SHARD_MERGE_FRAMES  65536
+
+
+void tr_shard_range(tr_shard* pShard, unsigned int pIndex, unsigned int pCount, unsigned int pTotalFrames, unsigned int pBlockSize)
+{
+	unsigned long long blocks = (pTotalFrames + pBlockSize - 1) / pBlockSize;
+	unsigned long long start  = blocks * (pIndex - 1) / pCount * pBlockSize;
+	unsigned long long end    = blocks * pIndex / pCount * pBlockSize;
+	
+	pShard->index       = pIndex;
+	pShard->count       = pCount;
+	pShard->blocksize   = pBlockSize;
+	pShard->totalframes = pTotalFrames;
+	pShard->start       = start < pTotalFrames ? start : pTotalFrames;
+	pShard->end         = end < pTotalFrames ? end : pTotalFrames;
+	pShard->complete    = 0;
+	pShard->peak        = 0.0f;
+}
+
+/**
+	The header is written first with complete clear and again at the end, a partial
+	left by a process that died is refused by the merge
+*/
+int tr_shard_render(tr_shard* pShard, tr_stream* pStream, tr_wavfile* pInput, unsigned int pInputFrames, FILE* pFile)
+{
+	unsigned int channels  = pStream->channels;
+	unsigned int blocksize = pStream->blocksize;
+	unsigned int warmup    = pStream->convolvers[0].partitions * blocksize;
+	unsigned int pos       = pShard->start > warmup ? pShard->start - warmup : 0;
+	uint32_t header[2] = { TR_SHARD_MAGIC, TR_SHARD_VERSION };
+	unsigned int i;
+	
+	fseek(pFile, 0, SEEK_SET);
+	if(fwrite(header, sizeof(uint32_t), 2, pFile) != 2 || fwrite(pShard, sizeof(tr_shard), 1, pFile) != 1)
+	{
+		return 0;
+	}
+	
+	float* inblock  = malloc(blocksize * channels * sizeof(float));
+	float* outblock = malloc(blocksize * channels * sizeof(float));
+	int ok = 1;
+	
+	tr_stream_reset(pStream);
+	tr_wavseek(pInput, pos * channels);
+	
+	for(; pos < pShard->end; pos += blocksize)
+	{
+		unsigned int count = pos < pInputFrames ? pInputFrames - pos : 0;
+		if(count > blocksize)
+		{
+			count = blocksize;
+		}
+		if(count > 0 && !tr_wavread(pInput, inblock, count * channels))
+		{
+			ok = 0;
+			break;
+		}
+		memset(inblock + count * channels, 0, (blocksize - count) * channels * sizeof(float));
+		
+		/* Blocks ahead of the shard only fill the delay lines */
+		if(pos < pShard->start)
+		{
+			tr_stream_push(pStream, inblock);
+			continue;
+		}
+		tr_stream_process(pStream, inblock, outblock);
+		
+		unsigned int keep = pShard->end - pos < blocksize ? pShard->end - pos : blocksize;
+		for(i = 0; i < keep * channels; i++)
+		{
+			if(outblock[i] > pShard->peak)
+			{
+				pShard->peak = outblock[i];
+			}
+		}
+		if(fwrite(outblock, sizeof(float), keep * channels, pFile) != keep * channels)
+		{
+			ok = 0;
+			break;
+		}
+	}
+	
+	free(inblock);
+	free(outblock);
+	
+	if(ok)
+	{
+		pShard->complete = 1;
+		fseek(pFile, 2 * sizeof(uint32_t), SEEK_SET);
+		ok = fwrite(pShard, sizeof(tr_shard), 1, pFile) == 1;
+	}
+	return ok;
+}
+
+int tr_shard_readheader(tr_shard* pShard, FILE* pFile)
+{
+	uint32_t header[2];
+	fseek(pFile, 0, SEEK_SET);
+	return fread(header, sizeof(uint32_t), 2, pFile) == 2 && header[0] == TR_SHARD_MAGIC && header[1] == TR_SHARD_VERSION
+	    && fread(pShard, sizeof(tr_shard), 1, pFile) == 1
+	    && pShard->count >= 1 && pShard->count <= TR_SHARD_MAX && pShard->channels > 0;
+}
+
+int tr_shard_merge(FILE** pPartials, const tr_shard* pShards, unsigned int pCount, tr_wavfile* pOutput)
+{
+	unsigned int i, s;
+	unsigned int expected = 0;
+	float peak = 0.0f;
+	
+	for(s = 0; s < pCount; s++)
+	{
+		const tr_shard* shard = &pShards[s];
+		if(!shard->complete || shard->index != s + 1 || shard->count != pCount || shard->start != expected
+		   || shard->channels != pShards[0].channels || shard->samplerate != pShards[0].samplerate
+		   || shard->bytespersample != pShards[0].bytespersample
+		   || shard->blocksize != pShards[0].blocksize || shard->radix != pShards[0].radix
+		   || shard->precision != pShards[0].precision || shard->doubleaccum != pShards[0].doubleaccum
+		   || shard->input != pShards[0].input || shard->response != pShards[0].response
+		   || shard->totalframes != pShards[0].totalframes)
+		{
+			return 0;
+		}
+		expected = shard->end;
+		
+		if(shard->peak > peak)
+		{
+			peak = shard->peak;
+		}
+	}
+	if(expected != pShards[0].totalframes)
+	{
+		return 0;
+	}
+	
+	unsigned int channels = pShards[0].channels;
+	float normalise = 1.0f / peak;
+	float* buffer = malloc(TR_SHARD_MERGE_FRAMES * channels * sizeof(float));
+	int ok = 1;
+	
+	for(s = 0; s < pCount && ok; s++)
+	{
+		fseek(pPartials[s], 2 * sizeof(uint32_t) + sizeof(tr_shard), SEEK_SET);
+		
+		unsigned int pos;
+		for(pos = pShards[s].start; pos < pShards[s].end; pos += TR_SHARD_MERGE_FRAMES)
+		{
+			unsigned int count = pShards[s].end - pos < TR_SHARD_MERGE_FRAMES ? pShards[s].end - pos : TR_SHARD_MERGE_FRAMES;
+			if(fread(buffer, sizeof(float), count * channels, pPartials[s]) != count * channels)
+			{
+				ok = 0;
+				break;
+			}
+			for(i = 0; i < count * channels; i++)
+			{
+				buffer[i] *= normalise;
+			}
+			if(!tr_wavwrite(pOutput, buffer, count * channels))
+			{
+				ok = 0;
+				break;
+			}
+		}
+	}
+	
+	free(buffer);
+	return ok;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
@@ -0,0 +1,276 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sparse.h"
+#include "convolve.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+static void tr_sparse_taps1(float* pDest, const float* pSource, float pGain, unsigned int pCount);
+static void tr_sparse_taps4(float* pDest, const float* const* pSources, const float* pGains, unsigned int pCount);
+static void tr_sparse_chunk(const tr_sparse* pPlan, const float* pInput, unsigned int pInLen, float* pOutput, unsigned int pStart, unsigned int pEnd);
+
+void tr_sparse_taps1(float* pDest, const float* pSource, float pGain, unsigned int pCount)
+{
+	unsigned int n = 0;
+	
+#if defined(__AVX__)
+	__m256 g = _mm256_set1_ps(pGain);
+	for(; n + 8 <= pCount; n += 8)
+	{
+		_mm256_storeu_ps(pDest + n, _mm256_add_ps(_mm256_loadu_ps(pDest + n), _mm256_mul_ps(g, _mm256_loadu_ps(pSource + n))));
+	}
+#elif defined(__SSE2__)
+	__m128 g = _mm_set1_ps(pGain);
+	for(; n + 4 <= pCount; n += 4)
+	{
+		_mm_storeu_ps(pDest + n, _mm_add_ps(_mm_loadu_ps(pDest + n), _mm_mul_ps(g, _mm_loadu_ps(pSource + n))));
+	}
+#endif
+	
+	for(; n < pCount; n++)
+	{
+		pDest[n] += pGain * pSource[n];
+	}
+}
+
+/**
+	Four taps at once, gathered from four places in the input, so the output is only
+	loaded and stored once for every four taps.
+*/
+void tr_sparse_taps4(float* pDest, const float* const* pSources, const float* pGains, unsigned int pCount)
+{
+	const float* s0 = pSources[0];
+	const float* s1 = pSources[1];
+	const float* s2 = pSources[2];
+	const float* s3 = pSources[3];
+	unsigned int n = 0;
+	
+#if defined(__AVX__)
+	__m256 g0 = _mm256_set1_ps(pGains[0]);
+	__m256 g1 = _mm256_set1_ps(pGains[1]);
+	__m256 g2 = _mm256_set1_ps(pGains[2]);
+	__m256 g3 = _mm256_set1_ps(pGains[3]);
+	for(; n + 8 <= pCount; n += 8)
+	{
+		__m256 a = _mm256_add_ps(_mm256_mul_ps(g0, _mm256_loadu_ps(s0 + n)), _mm256_mul_ps(g1, _mm256_loadu_ps(s1 + n)));
+		__m256 b = _mm256_add_ps(_mm256_mul_ps(g2, _mm256_loadu_ps(s2 + n)), _mm256_mul_ps(g3, _mm256_loadu_ps(s3 + n)));
+		_mm256_storeu_ps(pDest + n, _mm256_add_ps(_mm256_loadu_ps(pDest + n), _mm256_add_ps(a, b)));
+	}
+#elif defined(__SSE2__)
+	__m128 g0 = _mm_set1_ps(pGains[0]);
+	__m128 g1 = _mm_set1_ps(pGains[1]);
+	__m128 g2 = _mm_set1_ps(pGains[2]);
+	__m128 g3 = _mm_set1_ps(pGains[3]);
+	for(; n + 4 <= pCount; n += 4)
+	{
+		__m128 a = _mm_add_ps(_mm_mul_ps(g0, _mm_loadu_ps(s0 + n)), _mm_mul_ps(g1, _mm_loadu_ps(s1 + n)));
+		__m128 b = _mm_add_ps(_mm_mul_ps(g2, _mm_loadu_ps(s2 + n)), _mm_mul_ps(g3, _mm_loadu_ps(s3 + n)));
+		_mm_storeu_ps(pDest + n, _mm_add_ps(_mm_loadu_ps(pDest + n), _mm_add_ps(a, b)));
+	}
+#endif
+	
+	for(; n < pCount; n++)
+	{
+		pDest[n] += (pGains[0] * s0[n] + pGains[1] * s1[n]) + (pGains[2] * s2[n] + pGains[3] * s3[n]);
+	}
+}
+
+/**
+	Adds every tap to pOutput[pStart..pEnd).  Tap k covers output samples
+	[d_k, d_k + pInLen), a group of four runs together where all of them cover
+	the output and each one finishes its own edges alone.
+*/
+void tr_sparse_chunk(const tr_sparse* pPlan, const float* pInput, unsigned int pInLen, float* pOutput, unsigned int pStart, unsigned int pEnd)
+{
+	unsigned int k = 0;
+	for(; k < pPlan->taps && pPlan->delays[k] < pEnd; k += 4)
+	{
+		unsigned int group = pPlan->taps - k < 4 ? pPlan->taps - k : 4;
+		unsigned int tlo[4];
+		unsigned int thi[4];
+		unsigned int lo = pStart;
+		unsigned int hi = pEnd;
+		unsigned int j;
+		for(j = 0; j < group; j++)
+		{
+			unsigned int d = pPlan->delays[k + j];
+			tlo[j] = d > pStart ? d : pStart;
+			thi[j] = d + pInLen < pEnd ? d + pInLen : pEnd;
+			lo = tlo[j] > lo ? tlo[j] : lo;
+			hi = thi[j] < hi ? thi[j] : hi;
+		}
+		
+		if(group == 4 && lo < hi)
+		{
+			const float* sources[4];
+			for(j = 0; j < 4; j++)
+			{
+				sources[j] = pInput + (lo - pPlan->delays[k + j]);
+			}
+			tr_sparse_taps4(pOutput + lo, sources, pPlan->gains + k, hi - lo);
+		}
+		else
+		{
+			lo = hi = pEnd;
+		}
+		
+		for(j = 0; j < group; j++)
+		{
+			unsigned int d    = pPlan->delays[k + j];
+			float        gain = pPlan->gains[k + j];
+			unsigned int end  = thi[j] < lo ? thi[j] : lo;
+			if(tlo[j] < end)
+			{
+				tr_sparse_taps1(pOutput + tlo[j], pInput + (tlo[j] - d), gain, end - tlo[j]);
+			}
+			unsigned int start = tlo[j] > hi ? tlo[j] : hi;
+			if(start < thi[j])
+			{
+				tr_sparse_taps1(pOutput + start, pInput + (start - d), gain, thi[j] - start);
+			}
+		}
+	}
+}
+
+int tr_sparse_plan(tr_sparse* pPlan, const float* pResponse, unsigned int pReLen, unsigned int pBlockSize, float pFloor)
+{
+	float peak = 0.0f;
+	unsigned int i;
+	for(i = 0; i < pReLen; i++)
+	{
+		peak = fabsf(pResponse[i]) > peak ? fabsf(pResponse[i]) : peak;
+	}
+	const float threshold = peak * pFloor;
+	
+	unsigned int taps = 0;
+	for(i = 0; i < pReLen; i++)
+	{
+		taps += fabsf(pResponse[i]) > threshold;
+	}
+	
+	/* Start with the whole response as taps and move one partition at a time into the tail,
+	   the tail always ends with the response so only its last partition is partly empty */
+	unsigned int total = (pReLen + pBlockSize - 1) / pBlockSize;
+	unsigned int split = pReLen;
+	float        best  = taps;
+	
+	pPlan->split      = pReLen;
+	pPlan->partitions = 0;
+	
+	unsigned int k;
+	for(k = 1; k <= total; k++)
+	{
+		unsigned int next = pReLen > k * pBlockSize ? pReLen - k * pBlockSize : 0;
+		for(i = next; i < split; i++)
+		{
+			taps -= fabsf(pResponse[i]) > threshold;
+		}
+		split = next;
+		
+		float cost = taps + TR_SPARSE_TRANSFORM_COST + k * TR_SPARSE_PARTITION_COST;
+		if(cost < best)
+		{
+			best = cost;
+			pPlan->split      = split;
+			pPlan->partitions = k;
+		}
+	}
+	
+	pPlan->taps = 0;
+	for(i = 0; i < pPlan->split; i++)
+	{
+		pPlan->taps += fabsf(pResponse[i]) > threshold;
+	}
+	pPlan->delays = malloc((pPlan->taps ? pPlan->taps : 1) * sizeof(unsigned int));
+	pPlan->gains  = malloc((pPlan->taps ? pPlan->taps : 1) * sizeof(float));
+	if(!pPlan->delays || !pPlan->gains)
+	{
+		tr_sparse_free(pPlan);
+		return 0;
+	}
+	
+	unsigned int t = 0;
+	for(i = 0; i < pPlan->split; i++)
+	{
+		if(fabsf(pResponse[i]) > threshold)
+		{
+			pPlan->delays[t] = i;
+			pPlan->gains[t]  = pResponse[i];
+			t++;
+		}
+	}
+	return 1;
+}
+
+void tr_sparse_free(tr_sparse* pPlan)
+{
+	free(pPlan->delays);
+	free(pPlan->gains);
+	pPlan->delays = NULL;
+	pPlan->gains  = NULL;
+	pPlan->taps   = 0;
+}
+
+int tr_sparse_convolve(const tr_sparse* pPlan, tr_convolver* pConv, int pPrecision, const float* pInput, unsigned int pInLen,
+                       const float* pResponse, unsigned int pReLen, float* pOutput, unsigned int pOutLen)
+{
+	/* Tail first, it overwrites its part of the output and the taps are added on top */
+	unsigned int head = pPlan->split < pOutLen ? pPlan->split : pOutLen;
+	memset(pOutput, 0, head * sizeof(float));
+	if(pPlan->partitions > 0 && head < pOutLen)
+	{
+		tr_irspectra spectra;
+		if( !tr_irspectra_init(&spectra, &pConv->fft, pResponse + pPlan->split, pReLen - pPlan->split, pPrecision) )
+		{
+			return 0;
+		}
+		tr_convolve_fft(pConv, &spectra, pInput, pInLen, pOutput + head, pOutLen - head);
+		tr_irspectra_free(&spectra);
+	}
+	else
+	{
+		memset(pOutput + head, 0, (pOutLen - head) * sizeof(float));
+	}
+	
+	unsigned int n;
+	for(n = 0; n < pOutLen; n += TR_SPARSE_CHUNK)
+	{
+		tr_sparse_chunk(pPlan, pInput, pInLen, pOutput, n, n + TR_SPARSE_CHUNK < pOutLen ? n + TR_SPARSE_CHUNK : pOutLen);
+	}
+	return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
@@ -0,0 +1,154 @@
+/*
+    This file is part of Trillian.
+    Audio convolution utility.
+    Trillian homepage : http://code.google.com/p/trillian.
+
+    Copyright (C) 2010  Mike Jones
+
+    Trillian is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Trillian is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stream.h"
+#include "convolve.h"
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+
+int tr_stream_init(tr_stream* pStream, const float* pResponse, unsigned int pFrames, unsigned int pChannels,
+                   unsigned int pBlockSize, unsigned int pRadix, int pPrecision, int pDoubleAccum)
+{
+	unsigned int partitions = (pFrames + pBlockSize - 1) / pBlockSize;
+	
+	pStream->channels   = pChannels;
+	pStream->blocksize  = pBlockSize;
+	pStream->convolvers = malloc(pChannels * sizeof(tr_convolver));
+	pStream->spectra    = malloc(pChannels * sizeof(tr_irspectra));
+	pStream->block      = malloc(pBlockSize * sizeof(float));
+	
+	float* response = malloc(pFrames * sizeof(float));
+	
+	if(!pStream->convolvers || !pStream->spectra || !pStream->block || !response)
+	{
+		pStream->channels = 0;
+		tr_stream_free(pStream);
+		free(response);
+		return 0;
+	}
+	
+	unsigned int c;
+	for(c = 0; c < pChannels; c++)
+	{
+		if( !tr_convolver_init(&pStream->convolvers[c], pBlockSize, partitions) )
+		{
+			break;
+		}
+		pStream->convolvers[c].fft.radix   = pRadix;
+		pStream->convolvers[c].doubleaccum = pDoubleAccum;
+		
+		tr_deinterleave(pResponse, response, pChannels, c, pFrames);
+		if( !tr_irspectra_init(&pStream->spectra[c], &pStream->convolvers[c].fft, response, pFrames, pPrecision) )
+		{
+			tr_convolver_free(&pStream->convolvers[c]);
+			break;
+		}
+	}
+	free(response);
+	
+	/* Only the channels set up so far are freed */
+	if(c < pChannels)
+	{
+		pStream->channels = c;
+		tr_stream_free(pStream);
+		return 0;
+	}
+	return 1;
+}
+
+void tr_stream_free(tr_stream* pStream)
+{
+	unsigned int c;
+	for(c = 0; c < pStream->channels; c++)
+	{
+		tr_irspectra_free(&pStream->spectra[c]);
+		tr_convolver_free(&pStream->convolvers[c]);
+	}
+	free(pStream->convolvers);
+	free(pStream->spectra);
+	free(pStream->block);
+}
+
+void tr_stream_reset(tr_stream* pStream)
+{
+	unsigned int c;
+	for(c = 0; c < pStream->channels; c++)
+	{
+		tr_convolver_reset(&pStream->convolvers[c]);
+	}
+}
+
+void tr_stream_process(tr_stream* pStream, const float* pInput, float* pOutput)
+{
+	unsigned int c;
+	for(c = 0; c < pStream->channels; c++)
+	{
+		tr_deinterleave(pInput, pStream->block, pStream->channels, c, pStream->blocksize);
+		tr_convolver_push(&pStream->convolvers[c], pStream->block);
+		tr_convolver_pull(&pStream->convolvers[c], &pStream->spectra[c], pStream->block);
+		tr_interleave(pStream->block, pOutput, pStream->channels, c, pStream->blocksize);
+	}
+}
+
+void tr_stream_push(tr_stream* pStream, const float* pInput)
+{
+	unsigned int c;
+	for(c = 0; c < pStream->channels; c++)
+	{
+		tr_deinterleave(pInput, pStream->block, pStream->channels, c, pStream->blocksize);
+		tr_convolver_push(&pStream->convolvers[c], pStream->block);
+	}
+}
+
+int tr_stream_save(const tr_stream* pStream, FILE* pFile)
+{
+	unsigned int c;
+	for(c = 0; c < pStream->channels; c++)
+	{
+		if( !tr_convolver_save(&pStream->convolvers[c], pFile) )
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int tr_stream_load(tr_stream* pStream, FILE* pFile)
+{
+	unsigned int c;
+	for(c = 0; c < pStream->channels; c++)
+	{
+		if( !tr_convolver_load(&pStream->convolvers[c], pFile) )
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
\ No newline at end of file
@@ -23,24 +23,90 @@
 #include <stdlib.h>
 #include <getopt.h>
 #include <string.h>
+#include <math.h>
 
 #include "wavfile.h"
 #include "endian.h"
+#include "convolve.h"
+#include "multirate.h"
+#include "convolver.h"
+#include "ircache.h"
+#include "automation.h"
+#include "planner.h"
+#include "stream.h"
+#include "checkpoint.h"
+#include "timer.h"
+#include "incremental.h"
+#include "shard.h"
+#include "realtime.h"
+#include "analysis.h"
+#include "sparse.h"
 
 #define TRILLIAN_MAJ_VER 0x00
 #define TRILLIAN_MIN_VER 0x0000
 #define TRILLIAN_INC_VER 0x000004
 
+#define TR_ENGINE_DIRECT 0
+#define TR_ENGINE_FFT    1
+#define TR_ENGINE_SPARSE 2
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
 static int quiet = 0; /*quiet mode flag*/
 static char* outfilename = NULL;
+static int multirate = 0;            /* convolve the late tail at a decimated rate */
+static float multirateerror = -50.0f; /* dB, worst error allowed for the late tail */
+static float crossover = 80.0f;       /* ms, start of the late tail */
+static int engine = TR_ENGINE_DIRECT;
+static int enginechosen = 0;          /* --engine was given, modes that only have the fft engine refuse others */
+static float sparsefloor = 0.0f;      /* dB below the response peak that sparse taps are dropped, 0 keeps them all */
+static char* automationfilename = NULL;
+static float fade = 50.0f;            /* ms, crossfade when the response changes */
+static int irprecision = TR_IRSPECTRA_FLOAT;
+static int doubleaccum = 0;           /* accumulate in double precision */
+static int planmode = TR_PLAN_ESTIMATE;
+static char* wisdomfilename = NULL;
+static int checkpoint = 0;            /* stream the render, saving progress as it goes */
+static char* checkpointfilename = NULL;
+static float checkpointinterval = 60.0f; /* seconds between checkpoints */
+static int resume = 0;
+static char* updatefilename = NULL;   /* previous output to patch in place */
+static char* originalfilename = NULL; /* input the previous output was rendered from */
+static float* edits = NULL;           /* seconds, start and end pairs of edited input */
+static unsigned int editcount = 0;
+static int mix = 0;                   /* sum the responses of a send bus into one output */
+static float* mixweights = NULL;
+static unsigned int mixweightcount = 0;
+static unsigned int shardindex = 0;   /* render shard shardindex of shardcount into a partial file */
+static unsigned int shardcount = 0;
+static int merge = 0;                 /* join the partial files of a sharded render */
+static unsigned int realtimeblock = 0; /* frames per callback of a simulated live render */
+static int analysis = 0;              /* measure loudness, peaks and bands while normalising */
+static char* analysisfilename = NULL; /* JSON report, - for stdout, default output.wav.json */
+static int loudnessnormalise = 0;     /* normalise to a loudness instead of the peak */
+static float loudnesstarget = -23.0f; /* LUFS */
+static int album = 0;                 /* the inputs are consecutive tracks, convolved without gaps */
+static int directio = 0;              /* write outputs with O_DIRECT */
 
 static void tr_version(void);
 static void tr_help(void);
 static void tr_parseoptions(int argc, char** argv);
+static float tr_output_gain(const char* pFilename, const float* pBuffer, unsigned int pSamples, const tr_wavfile* pFormat);
+static int  tr_write_wav(const char* pFilename, float* pBuffer, unsigned int pSamples, const tr_wavfile* pFormat, float pGain);
+static int  tr_write_output(const char* pFilename, float* pBuffer, unsigned int pSamples, const tr_wavfile* pFormat);
+static char* tr_output_filename(const char* pInputName, const char* pResponseName);
+static void tr_save_plan(const char* pFilename, const float* pResponse, unsigned int pResponseSamples, unsigned int pBlockSize, unsigned int pRadix);
+static char* tr_numbered_filename(const char* pPattern, unsigned int pNumber);
+static int  tr_input_hash(tr_wavfile* pWav, uint64_t* pHash);
+static int  tr_render_shard(tr_wavfile* pInputWav, const float* pResponse, unsigned int pResponseFrames, const tr_plan* pPlan);
+static int  tr_merge_shards(void);
+static int  tr_render_album(char** pTrackNames, unsigned int pTracks, const char* pResponseName);
+static int  tr_render_realtime(tr_wavfile* pInputWav, const float* pInput, const float* pResponse, unsigned int pResponseFrames, const tr_plan* pPlan);
+static int  tr_render_bus(tr_wavfile* pInputWav, const char* pInputName, const float* pInput, char** pResponseNames, unsigned int pCount, const tr_plan* pPlan);
+static int  tr_render_stream(tr_wavfile* pInputWav, const float* pResponse, unsigned int pResponseFrames, const tr_plan* pPlan);
+static int  tr_render_update(tr_wavfile* pInputWav, const float* pResponse, unsigned int pResponseFrames);
 
 /* Valid long options */
 struct option tr_long_options[] = {
@@ -49,6 +115,30 @@ struct option tr_long_options[] = {
 	{"quiet", 0, 0, 's'},
 	{"silent", 0, 0, 's'},
 	{"output", 1, 0, 'o'},
+	{"multirate", 2, 0, 'm'},
+	{"crossover", 1, 0, 'x'},
+	{"engine", 1, 0, 'e'},
+	{"automation", 1, 0, 'a'},
+	{"fade", 1, 0, 'f'},
+	{"ir-precision", 1, 0, 'p'},
+	{"double", 0, 0, 'd'},
+	{"plan", 1, 0, 'l'},
+	{"wisdom", 1, 0, 'w'},
+	{"checkpoint", 2, 0, 'c'},
+	{"checkpoint-interval", 1, 0, 'i'},
+	{"resume", 0, 0, 'r'},
+	{"update", 1, 0, 'u'},
+	{"original", 1, 0, 'g'},
+	{"edit", 1, 0, 't'},
+	{"mix", 2, 0, 'b'},
+	{"shard", 1, 0, 'k'},
+	{"merge", 0, 0, 'j'},
+	{"realtime-sim", 2, 0, 'y'},
+	{"analysis", 2, 0, 'z'},
+	{"loudness", 1, 0, 'n'},
+	{"album", 0, 0, 'A'},
+	{"direct-io", 0, 0, 'D'},
+	{"sparse-floor", 1, 0, 'S'},
 	{NULL, 0, 0, 0}
 };
 
@@ -61,50 +151,1751 @@ static void tr_version(void)
 	fprintf(stdout, "There is NO WARRANTY, to the extent permitted by law.\n");
 }
 
-static void tr_help(void)
-{
-	tr_version();
-	fprintf(stdout, "\n");
-	fprintf(stdout, "Usage: trillian [options] input.wav response.wav \n");
-	fprintf(stdout, "Options: \n");
-	fprintf(stdout, "  -h, --help             Show this message and exit. \n");
-	fprintf(stdout, "  -v, --version          Display version number and exit. \n");
-	fprintf(stdout, "  -s, --silent, --quiet  Quiet mode; no output to console (stdout). \n");
-	fprintf(stdout, "  -o, --output           Use given filename for output wav file. \n");
-	fprintf(stdout, "\n");
-	fprintf(stdout, "Report bugs to     : trillian-discuss@googlegroups.com \n");
-	fprintf(stdout, "Trillian home page : http://code.google.com/p/trillian \n");
-}
+static void tr_help(void)
+{
+	tr_version();
+	fprintf(stdout, "\n");
+	fprintf(stdout, "Usage: trillian [options] input.wav response.wav [response2.wav ...] \n");
+	fprintf(stdout, "       trillian --merge -o output.wav \n");
+	fprintf(stdout, "       trillian --album [options] track1.wav track2.wav ... response.wav \n");
+	fprintf(stdout, "Options: \n");
+	fprintf(stdout, "  -h, --help             Show this message and exit. \n");
+	fprintf(stdout, "  -v, --version          Display version number and exit. \n");
+	fprintf(stdout, "  -s, --silent, --quiet  Quiet mode; no output to console (stdout). \n");
+	fprintf(stdout, "  -o, --output           Use given filename for output wav file. \n");
+	fprintf(stdout, "  -m, --multirate[=dB]   Convolve the late tail at a decimated rate, keeping \n");
+	fprintf(stdout, "                         its error below the given level (default -50dB). \n");
+	fprintf(stdout, "  -x, --crossover=ms     Start of the late tail for --multirate (default 80ms). \n");
+	fprintf(stdout, "  -e, --engine=name      Convolution engine, direct (default), fft or sparse. \n");
+	fprintf(stdout, "                         sparse runs the early reflections as taps and the \n");
+	fprintf(stdout, "                         dense tail with the fft engine. \n");
+	fprintf(stdout, "  -S, --sparse-floor=dB  Drop early samples this far below the response peak \n");
+	fprintf(stdout, "                         instead of making them taps, so a noise floor or \n");
+	fprintf(stdout, "                         dither does not stop the split.  Lossy, by default \n");
+	fprintf(stdout, "                         every nonzero sample is kept and sparse is exact. \n");
+	fprintf(stdout, "  -a, --automation=file  Change response over time, each line of the file is \n");
+	fprintf(stdout, "                         'seconds response.wav'.  Uses the fft engine. \n");
+	fprintf(stdout, "  -f, --fade=ms          Crossfade when the response changes (default 50ms). \n");
+	fprintf(stdout, "  -p, --ir-precision=p   Store response spectra of the fft engine as float \n");
+	fprintf(stdout, "                         (default), half or bfloat16. \n");
+	fprintf(stdout, "  -d, --double           Accumulate in double precision, for long responses \n");
+	fprintf(stdout, "                         where float sums lose accuracy. \n");
+	fprintf(stdout, "  -l, --plan=mode        How the fft engine picks its block size and radix, \n");
+	fprintf(stdout, "                         estimate (default), measure or exhaustive. \n");
+	fprintf(stdout, "  -w, --wisdom=file      Where measured plans are kept (default ~/.trillian_wisdom). \n");
+	fprintf(stdout, "  -c, --checkpoint=file  Stream the render with the fft engine, saving progress \n");
+	fprintf(stdout, "                         to file (default output.wav.checkpoint). \n");
+	fprintf(stdout, "  -i, --checkpoint-interval=seconds \n");
+	fprintf(stdout, "                         Time between checkpoints (default 60). \n");
+	fprintf(stdout, "  -r, --resume           Carry on from the checkpoint of an interrupted render. \n");
+	fprintf(stdout, "  -u, --update=file      Patch a previous fft engine output in place, only \n");
+	fprintf(stdout, "                         re-convolving what the changed input touches. \n");
+	fprintf(stdout, "                         Uses the file.plan an fft render leaves next to its \n");
+	fprintf(stdout, "                         output, without it the file is rendered in full. \n");
+	fprintf(stdout, "  -g, --original=file    Input the previous output was made from, changes are \n");
+	fprintf(stdout, "                         found by comparing it with the new input. \n");
+	fprintf(stdout, "  -t, --edit=start:end   Seconds of input that changed, instead of --original. \n");
+	fprintf(stdout, "  -b, --mix[=w1,w2,...]  With several responses, sum them into one output with \n");
+	fprintf(stdout, "                         the given weights (default 1) instead of one output \n");
+	fprintf(stdout, "                         each.  Separate outputs are named by -o out_%%d.wav. \n");
+	fprintf(stdout, "  -k, --shard=k/N        Render part k of N of the output into output.wav.shardk, \n");
+	fprintf(stdout, "                         the parts can run as separate processes. \n");
+	fprintf(stdout, "  -j, --merge            Join the parts of a sharded render into the output. \n");
+	fprintf(stdout, "  -y, --realtime-sim[=frames]  Run the fft engine as live playback would, in \n");
+	fprintf(stdout, "                         callbacks of the given size (default 256), and report \n");
+	fprintf(stdout, "                         how each one compares with its deadline. \n");
+	fprintf(stdout, "  -z, --analysis[=file]  Measure integrated loudness, true peak, RMS and octave \n");
+	fprintf(stdout, "                         bands of the output into a JSON file (default \n");
+	fprintf(stdout, "                         output.wav.json, - for the console). \n");
+	fprintf(stdout, "  -n, --loudness=LUFS    Normalise to an integrated loudness instead of the peak. \n");
+	fprintf(stdout, "  -A, --album            Convolve consecutive tracks as one, each reverb tail \n");
+	fprintf(stdout, "                         runs into the next track.  Outputs keep the track \n");
+	fprintf(stdout, "                         lengths and share one gain, named by -o out_%%d.wav. \n");
+	fprintf(stdout, "                         Uses the fft engine. \n");
+	fprintf(stdout, "  -D, --direct-io        Write outputs past the page cache where the system \n");
+	fprintf(stdout, "                         allows it. \n");
+	fprintf(stdout, "\n");
+	fprintf(stdout, "Report bugs to     : trillian-discuss@googlegroups.com \n");
+	fprintf(stdout, "Trillian home page : http://code.google.com/p/trillian \n");
+}
+
+static void tr_parseoptions(int argc, char** argv)
+{
+	int option_index = 1;
+	int opt;
+	
+	while((opt = getopt_long(argc, argv, "vhso:m::x:e:a:f:p:dl:w:c::i:ru:g:t:b::k:jy::z::n:ADS:", tr_long_options, &option_index)) != -1)
+	{
+		switch(opt)
+		{
+			case 'h':
+				tr_help();
+				exit(0);
+				break;
+			case 'v':
+				tr_version();
+				exit(0);
+				break;
+			case 's':
+				quiet = 1;
+				break;
+			case 'o':
+				outfilename = strdup(optarg);
+				break;
+			case 'm':
+				multirate = 1;
+				if(optarg)
+				{
+					multirateerror = atof(optarg);
+				}
+				break;
+			case 'x':
+				crossover = atof(optarg);
+				if(!(crossover > 0.0f))
+				{
+					fprintf(stderr, "ERROR: Invalid crossover %s, use a time in ms above 0 \n", optarg);
+					exit(1);
+				}
+				break;
+			case 'e':
+				enginechosen = 1;
+				if(strcmp(optarg, "direct") == 0)
+				{
+					engine = TR_ENGINE_DIRECT;
+				}
+				else if(strcmp(optarg, "fft") == 0)
+				{
+					engine = TR_ENGINE_FFT;
+				}
+				else if(strcmp(optarg, "sparse") == 0)
+				{
+					engine = TR_ENGINE_SPARSE;
+				}
+				else
+				{
+					fprintf(stderr, "ERROR: Unknown engine %s. Use -h for help \n", optarg);
+					exit(1);
+				}
+				break;
+			case 'a':
+				automationfilename = strdup(optarg);
+				break;
+			case 'f':
+				fade = atof(optarg);
+				break;
+			case 'd':
+				doubleaccum = 1;
+				break;
+			case 'l':
+				if(strcmp(optarg, "estimate") == 0)
+				{
+					planmode = TR_PLAN_ESTIMATE;
+				}
+				else if(strcmp(optarg, "measure") == 0)
+				{
+					planmode = TR_PLAN_MEASURE;
+				}
+				else if(strcmp(optarg, "exhaustive") == 0)
+				{
+					planmode = TR_PLAN_EXHAUSTIVE;
+				}
+				else
+				{
+					fprintf(stderr, "ERROR: Unknown plan mode %s. Use -h for help \n", optarg);
+					exit(1);
+				}
+				break;
+			case 'w':
+				wisdomfilename = strdup(optarg);
+				break;
+			case 'c':
+				checkpoint = 1;
+				if(optarg)
+				{
+					checkpointfilename = strdup(optarg);
+				}
+				break;
+			case 'i':
+				checkpointinterval = atof(optarg);
+				break;
+			case 'r':
+				checkpoint = 1;
+				resume = 1;
+				break;
+			case 'u':
+				updatefilename = strdup(optarg);
+				break;
+			case 'g':
+				originalfilename = strdup(optarg);
+				break;
+			case 'b':
+				mix = 1;
+				if(optarg)
+				{
+					char* weight = optarg;
+					while(*weight)
+					{
+						char* end;
+						mixweights = realloc(mixweights, (mixweightcount + 1) * sizeof(float));
+						mixweights[mixweightcount++] = strtod(weight, &end);
+						if(end == weight || (*end != ',' && *end != '\0'))
+						{
+							fprintf(stderr, "ERROR: Invalid mix weights %s. Use -h for help \n", optarg);
+							exit(1);
+						}
+						weight = *end ? end + 1 : end;
+					}
+				}
+				break;
+			case 'k':
+				if(sscanf(optarg, "%u/%u", &shardindex, &shardcount) != 2 || shardindex < 1 || shardindex > shardcount
+				   || shardcount > TR_SHARD_MAX)
+				{
+					fprintf(stderr, "ERROR: Invalid shard %s, use k/N with k from 1 to N and N up to %u \n", optarg, TR_SHARD_MAX);
+					exit(1);
+				}
+				break;
+			case 'j':
+				merge = 1;
+				break;
+			case 'z':
+				analysis = 1;
+				if(optarg)
+				{
+					analysisfilename = strdup(optarg);
+				}
+				break;
+			case 'n':
+				loudnessnormalise = 1;
+				loudnesstarget = atof(optarg);
+				break;
+			case 'A':
+				album = 1;
+				break;
+			case 'D':
+				directio = 1;
+				break;
+			case 'S':
+				sparsefloor = atof(optarg);
+				if(!(sparsefloor < 0.0f))
+				{
+					fprintf(stderr, "ERROR: Invalid sparse floor %s, use a level in dB below 0 \n", optarg);
+					exit(1);
+				}
+				break;
+			case 'y':
+				realtimeblock = optarg ? atoi(optarg) : 256;
+				if(realtimeblock < 16 || (realtimeblock & (realtimeblock - 1)))
+				{
+					fprintf(stderr, "ERROR: Invalid callback size %s, use a power of two from 16 \n", optarg);
+					exit(1);
+				}
+				break;
+			case 't':
+			{
+				float start, end;
+				if(sscanf(optarg, "%f:%f", &start, &end) != 2 || start < 0.0f || end < start)
+				{
+					fprintf(stderr, "ERROR: Invalid edit %s, use start:end in seconds \n", optarg);
+					exit(1);
+				}
+				edits = realloc(edits, (editcount + 1) * 2 * sizeof(float));
+				edits[editcount * 2]     = start;
+				edits[editcount * 2 + 1] = end;
+				++editcount;
+				break;
+			}
+			case 'p':
+				if(strcmp(optarg, "float") == 0)
+				{
+					irprecision = TR_IRSPECTRA_FLOAT;
+				}
+				else if(strcmp(optarg, "half") == 0)
+				{
+					irprecision = TR_IRSPECTRA_HALF;
+				}
+				else if(strcmp(optarg, "bfloat16") == 0)
+				{
+					irprecision = TR_IRSPECTRA_BFLOAT16;
+				}
+				else
+				{
+					fprintf(stderr, "ERROR: Unknown precision %s. Use -h for help \n", optarg);
+					exit(1);
+				}
+				break;
+			default:
+				fprintf(stderr, "ERROR: Invalid argument. Use -h for help \n");
+				exit(1); /* We probably could survive, better to just bail for now; at least that way we can guarentee nothing bad will happen */
+				break;
+		}
+	}
+}
+
+
+/**
+	Gain that normalises a whole render, to its peak or with --loudness to a loudness.
+	The --analysis report is made on the way.
+*/
+static float tr_output_gain(const char* pFilename, const float* pBuffer, unsigned int pSamples, const tr_wavfile* pFormat)
+{
+	if(!quiet)
+	{
+		fprintf(stdout, "Normalising audio\n");
+	}
+	
+	/* Normalise the data, the analysis works through the same chunks as the peak search */
+	const float* conv = pBuffer;
+	unsigned int i;
+	float maxsample = 0.0f;
+	
+	tr_analysis measure;
+	int measuring = analysis || loudnessnormalise;
+	if(measuring && !tr_analysis_init(&measure, pFormat->channels, pFormat->samplerate))
+	{
+		fprintf(stderr, "WARNING: Not enough memory to analyse the output, normalising to the peak\n");
+		measuring = 0;
+	}
+	
+	unsigned int chunk = 4096 * pFormat->channels;
+	unsigned int pos;
+	for(pos = 0; pos < pSamples; pos += chunk)
+	{
+		unsigned int count = pSamples - pos < chunk ? pSamples - pos : chunk;
+		for(i = 0; i < count; i++)
+		{
+			if(*conv > maxsample)
+			{
+				maxsample = *conv;
+			}
+			++conv;
+		}
+		if(measuring)
+		{
+			tr_analysis_process(&measure, pBuffer + pos, count / pFormat->channels);
+		}
+	}
+	
+	float normalise = 1.0f / maxsample;
+	double target = -HUGE_VAL, limit = 0.0;
+	
+	if(loudnessnormalise && measuring)
+	{
+		double loudness = tr_analysis_loudness(&measure);
+		if(loudness > -HUGE_VAL)
+		{
+			/* Never gain the true peak past full scale to reach the target */
+			double peak = tr_analysis_truepeak(&measure);
+			target = loudnesstarget;
+			normalise = pow(10.0, (loudnesstarget - loudness) / 20.0);
+			if(peak > 0.0)
+			{
+				limit = 1.0 / peak;
+				if(normalise > limit)
+				{
+					normalise = limit;
+					fprintf(stderr, "WARNING: %.2f LUFS would clip, true peak limits the output to %.2f LUFS\n",
+					   loudnesstarget, loudness + 20.0 * log10(limit));
+				}
+			}
+		}
+		else if(!quiet)
+		{
+			fprintf(stdout, "Output is too quiet to measure loudness, normalising to the peak\n");
+		}
+	}
+	
+	if(analysis && measuring)
+	{
+		FILE* report = stdout;
+		char* reportname = NULL;
+		if(analysisfilename && strcmp(analysisfilename, "-") != 0)
+		{
+			reportname = strdup(analysisfilename);
+			report = reportname ? fopen(reportname, "w") : NULL;
+		}
+		else if(!analysisfilename)
+		{
+			reportname = malloc(strlen(pFilename) + 6);
+			if(reportname)
+			{
+				strcpy(reportname, pFilename);
+				strcat(reportname, ".json");
+			}
+			report = reportname ? fopen(reportname, "w") : NULL;
+		}
+		if(report)
+		{
+			tr_analysis_json(&measure, report, pFilename, normalise, target, limit);
+			if(report != stdout)
+			{
+				fclose(report);
+			}
+		}
+		else
+		{
+			fprintf(stderr, "WARNING: Failed writing analysis %s\n", reportname ? reportname : pFilename);
+		}
+		free(reportname);
+	}
+	if(measuring)
+	{
+		tr_analysis_free(&measure);
+	}
+	
+	return normalise;
+}
+
+/**
+	Apply pGain and write a render out as a wav in pFormat
+*/
+static int tr_write_wav(const char* pFilename, float* pBuffer, unsigned int pSamples, const tr_wavfile* pFormat, float pGain)
+{
+	float* conv = pBuffer;
+	unsigned int i;
+	for(i = 0; i < pSamples; i++)
+	{
+		*conv++ *= pGain;
+	}
+	
+	/* Setup the output file */
+	FILE* outfile = fopen(pFilename, "wb");
+	if(outfile == 0)
+	{
+		fprintf(stderr, "ERROR: Failed opening output file %s\n", pFilename);
+		return 0;
+	}
+	
+	/* Whatever plan was kept for an earlier file of this name does not describe this one */
+	tr_incremental_removeplan(pFilename);
+	
+	tr_wavfile outwav;
+	tr_wavopen(outfile, &outwav, 'w');
+	outwav.channels       = pFormat->channels;
+	outwav.samplerate     = pFormat->samplerate;
+	outwav.bytespersample = pFormat->bytespersample;
+	
+	if(!quiet)
+	{
+		fprintf(stdout, "\n");
+		fprintf(stdout, "Output file        : %s\n", pFilename);
+		fprintf(stdout, "  Samples          : %u\n", pSamples);
+		fprintf(stdout, "  Channels         : %i\n", outwav.channels);
+		fprintf(stdout, "  Sample rate      : %u\n", outwav.samplerate);
+		fprintf(stdout, "  Bytes per sample : %u\n", outwav.bytespersample);
+		fprintf(stdout, "  Duration seconds : %.2f\n", ((float)pSamples / (float)outwav.samplerate / (float)outwav.channels));
+		
+		fprintf(stdout, "\n");
+		fprintf(stdout, "Writing data out to %s\n", pFilename);
+	}
+	
+	/* Write out data from the processing to file, the last of it only goes on close */
+	int ok = tr_wavreserve(&outwav, pSamples, directio);
+	if(!ok || !tr_wavwrite(&outwav, pBuffer, pSamples) || !tr_wavflush(&outwav))
+	{
+		fprintf(stderr, "ERROR: Failed during write of %s.  File may be malformed\n", pFilename);
+		ok = 0;
+	}
+	
+	int closed = tr_wavclose(&outwav);
+	if(fclose(outfile) != 0 || (ok && !closed))
+	{
+		fprintf(stderr, "ERROR: Failed finishing %s.  File may be malformed\n", pFilename);
+		ok = 0;
+	}
+	return ok;
+}
+
+/**
+	Normalise a whole render and write it out as a wav in pFormat
+*/
+static int tr_write_output(const char* pFilename, float* pBuffer, unsigned int pSamples, const tr_wavfile* pFormat)
+{
+	return tr_write_wav(pFilename, pBuffer, pSamples, pFormat, tr_output_gain(pFilename, pBuffer, pSamples, pFormat));
+}
+
+/**
+	Keep the plan an fft render of pFilename used, so --update can patch it the same way
+*/
+static void tr_save_plan(const char* pFilename, const float* pResponse, unsigned int pResponseSamples, unsigned int pBlockSize, unsigned int pRadix)
+{
+	tr_incremental_plan plan;
+	plan.blocksize   = pBlockSize;
+	plan.radix       = pRadix;
+	plan.precision   = irprecision;
+	plan.doubleaccum = doubleaccum;
+	plan.response    = tr_incremental_hash(pResponse, pResponseSamples);
+	
+	if( !tr_incremental_saveplan(pFilename, &plan) )
+	{
+		fprintf(stderr, "WARNING: Failed writing the plan of %s, it can not be updated\n", pFilename);
+	}
+}
+
+/**
+	Name an output after the input and response, input.wav with room.wav gives inputroom.wav
+*/
+static char* tr_output_filename(const char* pInputName, const char* pResponseName)
+{
+	const char* innameend = strrchr(pInputName, '.');
+	int innamelen = innameend ? innameend-pInputName : strlen(pInputName);
+	
+	const char* responsenameend = strrchr(pResponseName, '.');
+	int responsenamelen = responsenameend ? responsenameend-pResponseName : strlen(pResponseName);
+	
+	char* filename = malloc(innamelen+responsenamelen + 5); /* + '.wav '*/
+	memcpy(filename, pInputName, innamelen);
+	memcpy(filename + innamelen, pResponseName, responsenamelen);
+	strcpy(filename + innamelen + responsenamelen, ".wav");
+	return filename;
+}
+
+/**
+	Name one of several outputs, out_%d.wav counts from 1 and a name without %d gets
+	_1, _2 ... before its extension
+*/
+static char* tr_numbered_filename(const char* pPattern, unsigned int pNumber)
+{
+	char* filename = malloc(strlen(pPattern) + 16);
+	const char* number = strstr(pPattern, "%d");
+	if(number)
+	{
+		sprintf(filename, "%.*s%u%s", (int)(number - pPattern), pPattern, pNumber, number + 2);
+	}
+	else
+	{
+		const char* extension = strrchr(pPattern, '.');
+		int namelen = extension ? extension - pPattern : (int)strlen(pPattern);
+		sprintf(filename, "%.*s_%u%s", namelen, pPattern, pNumber, extension ? extension : "");
+	}
+	return filename;
+}
+
+/**
+	Hash of every sample of an input, a chunk at a time so it need not be in memory
+*/
+static int tr_input_hash(tr_wavfile* pWav, uint64_t* pHash)
+{
+	unsigned int chunk = 65536 * pWav->channels;
+	float* buffer = malloc(chunk * sizeof(float));
+	uint64_t hash = 14695981039346656037ull;
+	int ok = buffer != 0;
+	
+	unsigned int pos;
+	tr_wavseek(pWav, 0);
+	for(pos = 0; pos < pWav->totalsamples && ok; pos += chunk)
+	{
+		unsigned int count = pWav->totalsamples - pos < chunk ? pWav->totalsamples - pos : chunk;
+		ok = tr_wavread(pWav, buffer, count);
+		hash ^= tr_incremental_hash(buffer, count);
+		hash *= 1099511628211ull;
+	}
+	
+	free(buffer);
+	*pHash = hash;
+	return ok;
+}
+
+/**
+	Render one shard of the output into outfilename.shardk.  Every shard must use the
+	same plan, a measured plan is best made once and shared through the wisdom file.
+*/
+static int tr_render_shard(tr_wavfile* pInputWav, const float* pResponse, unsigned int pResponseFrames, const tr_plan* pPlan)
+{
+	unsigned int channels    = pInputWav->channels;
+	unsigned int inputframes = pInputWav->totalsamples / channels;
+	
+	tr_shard shard;
+	tr_shard_range(&shard, shardindex, shardcount, inputframes + pResponseFrames - 1, pPlan->blocksize);
+	shard.channels       = channels;
+	shard.samplerate     = pInputWav->samplerate;
+	shard.bytespersample = pInputWav->bytespersample;
+	shard.radix          = pPlan->radix;
+	shard.precision      = irprecision;
+	shard.doubleaccum    = doubleaccum;
+	shard.response       = tr_incremental_hash(pResponse, pResponseFrames * channels);
+	if( !tr_input_hash(pInputWav, &shard.input) )
+	{
+		fprintf(stderr, "ERROR: Failed reading input file\n");
+		return 0;
+	}
+	
+	tr_stream stream;
+	if( !tr_stream_init(&stream, pResponse, pResponseFrames, channels, pPlan->blocksize, pPlan->radix, irprecision, doubleaccum) )
+	{
+		fprintf(stderr, "ERROR: Unsupported block size %u\n", pPlan->blocksize);
+		return 0;
+	}
+	
+	char* partialname = malloc(strlen(outfilename) + 24);
+	sprintf(partialname, "%s.shard%u", outfilename, shardindex);
+	
+	FILE* partial = fopen(partialname, "wb");
+	if(partial == 0)
+	{
+		fprintf(stderr, "ERROR: Failed opening %s\n", partialname);
+		free(partialname);
+		tr_stream_free(&stream);
+		return 0;
+	}
+	
+	if(!quiet)
+	{
+		fprintf(stdout, "Shard %u of %u       : %.2f to %.2f seconds into %s\n", shardindex, shardcount,
+		   (float)shard.start / shard.samplerate, (float)shard.end / shard.samplerate, partialname);
+		fprintf(stdout, "Processing audio, please be patient\n");
+	}
+	
+	int ok = tr_shard_render(&shard, &stream, pInputWav, inputframes, partial);
+	if(!ok)
+	{
+		fprintf(stderr, "ERROR: Failed rendering %s\n", partialname);
+	}
+	
+	tr_stream_free(&stream);
+	fclose(partial);
+	free(partialname);
+	return ok;
+}
+
+/**
+	Join outfilename.shard1 to .shardN into outfilename, the count comes from the first
+*/
+static int tr_merge_shards(void)
+{
+	char* partialname = malloc(strlen(outfilename) + 24);
+	tr_shard first;
+	
+	sprintf(partialname, "%s.shard1", outfilename);
+	FILE* file = fopen(partialname, "rb");
+	if(file == 0 || !tr_shard_readheader(&first, file))
+	{
+		fprintf(stderr, "ERROR: Failed reading %s\n", partialname);
+		if(file)
+		{
+			fclose(file);
+		}
+		free(partialname);
+		return 0;
+	}
+	fclose(file);
+	
+	unsigned int count = first.count;
+	FILE** partials = calloc(count, sizeof(FILE*));
+	tr_shard* shards = malloc(count * sizeof(tr_shard));
+	unsigned int s;
+	int ok = 1;
+	
+	for(s = 0; s < count && ok; s++)
+	{
+		sprintf(partialname, "%s.shard%u", outfilename, s + 1);
+		partials[s] = fopen(partialname, "rb");
+		if(partials[s] == 0 || !tr_shard_readheader(&shards[s], partials[s]))
+		{
+			fprintf(stderr, "ERROR: Failed reading %s\n", partialname);
+			ok = 0;
+		}
+	}
+	
+	FILE* outfile = NULL;
+	if(ok)
+	{
+		tr_incremental_removeplan(outfilename);
+		outfile = fopen(outfilename, "wb");
+		if(outfile == 0)
+		{
+			fprintf(stderr, "ERROR: Failed opening output file %s\n", outfilename);
+			ok = 0;
+		}
+	}
+	
+	if(ok)
+	{
+		tr_wavfile outwav;
+		tr_wavopen(outfile, &outwav, 'w');
+		outwav.channels       = first.channels;
+		outwav.samplerate     = first.samplerate;
+		outwav.bytespersample = first.bytespersample;
+		
+		if(!quiet)
+		{
+			fprintf(stdout, "Merging %u shards into %s\n", count, outfilename);
+		}
+		
+		if( !tr_wavreserve(&outwav, first.totalframes * first.channels, directio) )
+		{
+			fprintf(stderr, "ERROR: Failed during write of %s\n", outfilename);
+			ok = 0;
+		}
+		else if( !tr_shard_merge(partials, shards, count, &outwav) )
+		{
+			fprintf(stderr, "ERROR: Shards of %s are incomplete or from different renders\n", outfilename);
+			ok = 0;
+		}
+		else if( !tr_wavflush(&outwav) )
+		{
+			fprintf(stderr, "ERROR: Failed during write of %s\n", outfilename);
+			ok = 0;
+		}
+		
+		int closed = tr_wavclose(&outwav);
+		if(fclose(outfile) != 0 || (ok && !closed))
+		{
+			fprintf(stderr, "ERROR: Failed finishing %s\n", outfilename);
+			ok = 0;
+		}
+	}
+	
+	for(s = 0; s < count; s++)
+	{
+		if(partials[s])
+		{
+			fclose(partials[s]);
+			if(ok)
+			{
+				sprintf(partialname, "%s.shard%u", outfilename, s + 1);
+				remove(partialname);
+			}
+		}
+	}
+	if(!ok && outfile)
+	{
+		remove(outfilename);
+	}
+	else if(ok)
+	{
+		/* The shards convolved exactly as one stream would, so the output can be updated */
+		tr_incremental_plan plan;
+		plan.blocksize   = first.blocksize;
+		plan.radix       = first.radix;
+		plan.precision   = first.precision;
+		plan.doubleaccum = first.doubleaccum;
+		plan.response    = first.response;
+		if( !tr_incremental_saveplan(outfilename, &plan) )
+		{
+			fprintf(stderr, "WARNING: Failed writing the plan of %s, it can not be updated\n", outfilename);
+		}
+	}
+	
+	free(partials);
+	free(shards);
+	free(partialname);
+	return ok;
+}
+
+/**
+	Simulated live render with callbacks of realtimeblock frames.  The convolver runs at
+	the callback size, so there is no latency beyond the device's own; everything is
+	allocated and touched before the first callback.  The output is written as usual.
+*/
+static int tr_render_realtime(tr_wavfile* pInputWav, const float* pInput, const float* pResponse, unsigned int pResponseFrames, const tr_plan* pPlan)
+{
+	unsigned int channels    = pInputWav->channels;
+	unsigned int inputframes = pInputWav->totalsamples / channels;
+	unsigned int totalframes = inputframes + pResponseFrames - 1;
+	unsigned int i;
+	
+	tr_stream stream;
+	if( !tr_stream_init(&stream, pResponse, pResponseFrames, channels, realtimeblock, pPlan->radix, irprecision, doubleaccum) )
+	{
+		fprintf(stderr, "ERROR: Unsupported callback size %u\n", realtimeblock);
+		return 0;
+	}
+	
+	float* outputbuffer = malloc((size_t)totalframes * channels * sizeof(float));
+	float* scratch      = malloc(realtimeblock * channels * sizeof(float));
+	if(!outputbuffer || !scratch)
+	{
+		fprintf(stderr, "ERROR: Out of memory for the output\n");
+		free(outputbuffer);
+		free(scratch);
+		tr_stream_free(&stream);
+		return 0;
+	}
+	memset(outputbuffer, 0, (size_t)totalframes * channels * sizeof(float));
+	memset(scratch, 0, realtimeblock * channels * sizeof(float));
+	
+	if(!quiet)
+	{
+		fprintf(stdout, "Simulating playback in callbacks of %u frames, %.2fms each\n", realtimeblock,
+		   1000.0 * realtimeblock / pInputWav->samplerate);
+	}
+	
+	tr_realtime_stats stats;
+	tr_realtime_simulate(&stream, pInput, inputframes, outputbuffer, totalframes, scratch, pInputWav->samplerate, &stats);
+	
+	/* The report goes out even in quiet mode, it is what was asked for */
+	fprintf(stdout, "\n");
+	fprintf(stdout, "Realtime simulation : %u callbacks of %.3fms, %u partitions\n", stats.blocks, stats.deadline * 1000.0,
+	   stream.convolvers[0].partitions);
+	fprintf(stdout, "  Average          : %.3fms, %.1f%% of the deadline\n", stats.total / stats.blocks * 1000.0,
+	   100.0 * stats.total / (stats.blocks * stats.deadline));
+	fprintf(stdout, "  Worst case       : %.3fms, %.1f%% of the deadline, callback %u\n", stats.worst * 1000.0,
+	   100.0 * stats.worst / stats.deadline, stats.worstblock);
+	fprintf(stdout, "  Xruns            : %u\n", stats.xruns);
+	fprintf(stdout, "  Histogram, time against deadline:\n");
+	for(i = 0; i < TR_REALTIME_BINS; i++)
+	{
+		if(i < 10)
+		{
+			fprintf(stdout, "    %3u-%3u%%       : %u\n", i * 10, i * 10 + 10, stats.histogram[i]);
+		}
+		else
+		{
+			fprintf(stdout, "    %s       : %u\n", i == 10 ? "100-200%" : "   >200%", stats.histogram[i]);
+		}
+	}
+	fprintf(stdout, "\n");
+	
+	int ok = tr_write_output(outfilename, outputbuffer, totalframes * channels, pInputWav);
+	
+	free(outputbuffer);
+	free(scratch);
+	tr_stream_free(&stream);
+	return ok;
+}
+
+/**
+	Consecutive tracks through one convolver as if they were one long input.  Each
+	output is as long as its track, so a track's reverb carries on into the start of
+	the next one and only the last keeps a tail.  The response is transformed once and
+	every track gets the gain of the whole album.
+*/
+static int tr_render_album(char** pTrackNames, unsigned int pTracks, const char* pResponseName)
+{
+	unsigned int t, c;
+	
+	FILE* responsefile = fopen(pResponseName, "rb");
+	tr_wavfile responsewav;
+	if(responsefile == 0)
+	{
+		fprintf(stderr, "ERROR: Failed opening response file %s\n", pResponseName);
+		return 0;
+	}
+	if(!tr_wavopen(responsefile, &responsewav, 'r'))
+	{
+		fprintf(stderr, "ERROR: Invalid file type, %s is not a wav file\n", pResponseName);
+		fclose(responsefile);
+		return 0;
+	}
+	
+	unsigned int channels       = responsewav.channels;
+	unsigned int framesresponse = responsewav.totalsamples / channels;
+	float* responsebuffer = malloc(responsewav.totalsamples * sizeof(float));
+	if(!responsebuffer || !tr_wavread(&responsewav, responsebuffer, responsewav.totalsamples))
+	{
+		fprintf(stderr, "ERROR: Failed reading response file %s\n", pResponseName);
+		free(responsebuffer);
+		fclose(responsefile);
+		return 0;
+	}
+	tr_wavclose(&responsewav);
+	fclose(responsefile);
+	
+	/* Track lengths first, then the tracks end to end in one buffer */
+	unsigned int* trackframes = malloc(pTracks * sizeof(unsigned int));
+	unsigned int framesinput = 0;
+	tr_wavfile format;
+	int ok = trackframes != 0;
+	
+	for(t = 0; t < pTracks && ok; t++)
+	{
+		FILE* file = fopen(pTrackNames[t], "rb");
+		tr_wavfile wav;
+		if(file == 0)
+		{
+			fprintf(stderr, "ERROR: Failed opening %s\n", pTrackNames[t]);
+			ok = 0;
+			break;
+		}
+		if(!tr_wavopen(file, &wav, 'r'))
+		{
+			fprintf(stderr, "ERROR: Invalid file type, %s is not a wav file\n", pTrackNames[t]);
+			ok = 0;
+		}
+		else if(wav.channels != channels || wav.samplerate != responsewav.samplerate)
+		{
+			fprintf(stderr, "ERROR: %s does not match the channels and sample rate of %s\n", pTrackNames[t], pResponseName);
+			ok = 0;
+		}
+		else
+		{
+			if(t == 0)
+			{
+				format = wav;
+			}
+			trackframes[t] = wav.totalsamples / channels;
+			framesinput += trackframes[t];
+		}
+		fclose(file);
+	}
+	if(!ok)
+	{
+		free(trackframes);
+		free(responsebuffer);
+		return 0;
+	}
+	
+	unsigned int framestotal = framesinput + framesresponse - 1;
+	float* inputbuffer  = malloc((size_t)framesinput * channels * sizeof(float));
+	float* outputbuffer = malloc((size_t)framestotal * channels * sizeof(float));
+	if(!inputbuffer || !outputbuffer)
+	{
+		fprintf(stderr, "ERROR: Not enough memory for %u tracks\n", pTracks);
+		ok = 0;
+	}
+	
+	if(!quiet && ok)
+	{
+		fprintf(stdout, "Album              : %u tracks, %.2f seconds through %s\n", pTracks,
+		   (float)framesinput / format.samplerate, pResponseName);
+		fprintf(stdout, "Reading tracks into memory\n");
+	}
+	
+	float* track = inputbuffer;
+	for(t = 0; t < pTracks && ok; t++)
+	{
+		FILE* file = fopen(pTrackNames[t], "rb");
+		tr_wavfile wav;
+		if(file == 0 || !tr_wavopen(file, &wav, 'r') || wav.totalsamples != trackframes[t] * channels
+		   || !tr_wavread(&wav, track, wav.totalsamples))
+		{
+			fprintf(stderr, "ERROR: Failed reading %s\n", pTrackNames[t]);
+			ok = 0;
+		}
+		else
+		{
+			track += wav.totalsamples;
+			tr_wavclose(&wav);
+		}
+		if(file)
+		{
+			fclose(file);
+		}
+	}
+	
+	tr_plan plan;
+	tr_convolver convolver;
+	tr_irspectra spectra;
+	float* channelinput    = 0;
+	float* channelresponse = 0;
+	float* channeloutput   = 0;
+	
+	if(ok)
+	{
+		tr_planner_plan(&plan, framesresponse, channels, planmode, wisdomfilename);
+		unsigned int partitions = (framesresponse + plan.blocksize - 1) / plan.blocksize;
+		
+		if(!quiet)
+		{
+			fprintf(stdout, "FFT plan           : block size %u, radix %u%s\n", plan.blocksize, plan.radix,
+			   plan.measured == 1 ? ", measured" : plan.measured == 2 ? ", from wisdom" : "");
+			fprintf(stdout, "Processing audio, please be patient\n");
+		}
+		
+		if( !tr_convolver_init(&convolver, plan.blocksize, partitions) )
+		{
+			fprintf(stderr, "ERROR: Unsupported block size %u\n", plan.blocksize);
+			ok = 0;
+		}
+	}
+	
+	if(ok)
+	{
+		convolver.fft.radix   = plan.radix;
+		convolver.doubleaccum = doubleaccum;
+		
+		channelinput    = malloc(framesinput * sizeof(float));
+		channelresponse = malloc(framesresponse * sizeof(float));
+		channeloutput   = malloc(framestotal * sizeof(float));
+		ok = channelinput && channelresponse && channeloutput;
+		
+		for(c = 0; c < channels && ok; c++)
+		{
+			tr_deinterleave(inputbuffer, channelinput, channels, c, framesinput);
+			tr_deinterleave(responsebuffer, channelresponse, channels, c, framesresponse);
+			
+			tr_convolver_reset(&convolver);
+			if( !tr_irspectra_init(&spectra, &convolver.fft, channelresponse, framesresponse, irprecision) )
+			{
+				ok = 0;
+				break;
+			}
+			tr_convolve_fft(&convolver, &spectra, channelinput, framesinput, channeloutput, framestotal);
+			tr_irspectra_free(&spectra);
+			
+			tr_interleave(channeloutput, outputbuffer, channels, c, framestotal);
+		}
+		if(!ok)
+		{
+			fprintf(stderr, "ERROR: Not enough memory for the response spectra\n");
+		}
+		
+		tr_convolver_free(&convolver);
+		free(channelinput);
+		free(channelresponse);
+		free(channeloutput);
+	}
+	
+	if(ok)
+	{
+		/* One gain, and one analysis report, for the whole album */
+		char* albumname = outfilename ? strdup(outfilename) : tr_output_filename(pTrackNames[0], pResponseName);
+		float gain = tr_output_gain(albumname, outputbuffer, framestotal * channels, &format);
+		free(albumname);
+		
+		float* output = outputbuffer;
+		for(t = 0; t < pTracks && ok; t++)
+		{
+			char* filename = outfilename ? tr_numbered_filename(outfilename, t + 1) : tr_output_filename(pTrackNames[t], pResponseName);
+			unsigned int frames = t + 1 < pTracks ? trackframes[t] : framestotal - (unsigned int)((output - outputbuffer) / channels);
+			
+			ok = tr_write_wav(filename, output, frames * channels, &format, gain);
+			output += (size_t)frames * channels;
+			free(filename);
+		}
+	}
+	
+	free(trackframes);
+	free(inputbuffer);
+	free(outputbuffer);
+	free(responsebuffer);
+	return ok;
+}
+
+/**
+	One input through several responses.  Each block of input is transformed once and
+	pulled against every response, then the outputs are normalised on their own, or
+	weighted and summed into a single output with --mix.
+*/
+static int tr_render_bus(tr_wavfile* pInputWav, const char* pInputName, const float* pInput, char** pResponseNames, unsigned int pCount, const tr_plan* pPlan)
+{
+	unsigned int channels    = pInputWav->channels;
+	unsigned int inputframes = pInputWav->totalsamples / channels;
+	unsigned int outputs     = mix ? 1 : pCount;
+	unsigned int i, c;
+	
+	tr_ircache cache;
+	if( !tr_ircache_init(&cache, pPlan->blocksize, irprecision) )
+	{
+		fprintf(stderr, "ERROR: Unsupported block size %u\n", pPlan->blocksize);
+		return 0;
+	}
+	cache.fft.radix = pPlan->radix;
+	
+	const tr_ircache_entry** entries = malloc(pCount * sizeof(tr_ircache_entry*));
+	unsigned int* framestotal = malloc(pCount * sizeof(unsigned int));
+	unsigned int partitions = 1;
+	int ok = entries && framestotal;
+	if(!ok)
+	{
+		fprintf(stderr, "ERROR: Not enough memory for %u responses\n", pCount);
+	}
+	
+	for(i = 0; i < pCount && ok; i++)
+	{
+		entries[i] = tr_ircache_get(&cache, pResponseNames[i]);
+		if(!entries[i])
+		{
+			fprintf(stderr, "ERROR: Failed loading response %s\n", pResponseNames[i]);
+			ok = 0;
+		}
+		else if(entries[i]->channels != channels || entries[i]->samplerate != pInputWav->samplerate)
+		{
+			fprintf(stderr, "ERROR: %s does not match the channels and sample rate of %s\n", pResponseNames[i], pInputName);
+			ok = 0;
+		}
+		else
+		{
+			framestotal[i] = inputframes + entries[i]->frames - 1;
+			if(entries[i]->spectra[0].partitions > partitions)
+			{
+				partitions = entries[i]->spectra[0].partitions;
+			}
+		}
+	}
+	
+	/* The mix is as long as the longest response makes it */
+	float* weights = NULL;
+	if(ok && mix)
+	{
+		for(i = 1; i < pCount; i++)
+		{
+			if(framestotal[i] > framestotal[0])
+			{
+				framestotal[0] = framestotal[i];
+			}
+		}
+		
+		weights = malloc(pCount * sizeof(float));
+		if(!weights)
+		{
+			fprintf(stderr, "ERROR: Not enough memory for %u responses\n", pCount);
+			ok = 0;
+		}
+		for(i = 0; i < pCount && ok; i++)
+		{
+			weights[i] = i < mixweightcount ? mixweights[i] : 1.0f;
+		}
+	}
+	
+	/* Zeroed so the buffers can be freed however far this got */
+	float** outputbuffers  = calloc(outputs, sizeof(float*));
+	float** channeloutputs = calloc(outputs, sizeof(float*));
+	const tr_irspectra** responses = malloc(pCount * sizeof(tr_irspectra*));
+	float* channelinput = malloc(inputframes * sizeof(float));
+	int allocated = outputbuffers && channeloutputs && responses && channelinput;
+	for(i = 0; i < outputs && ok && allocated; i++)
+	{
+		outputbuffers[i]  = malloc((size_t)framestotal[i] * channels * sizeof(float));
+		channeloutputs[i] = malloc(framestotal[i] * sizeof(float));
+		allocated = outputbuffers[i] && channeloutputs[i];
+	}
+	if(ok && !allocated)
+	{
+		fprintf(stderr, "ERROR: Not enough memory for %u outputs\n", outputs);
+		ok = 0;
+	}
+	
+	if(!quiet && ok)
+	{
+		fprintf(stdout, "Send bus           : %u responses into %u output%s\n", pCount, outputs, outputs > 1 ? "s" : "");
+		fprintf(stdout, "Processing audio, please be patient\n");
+	}
+	
+	tr_convolver convolver;
+	if(ok && !tr_convolver_init(&convolver, pPlan->blocksize, partitions))
+	{
+		fprintf(stderr, "ERROR: Unsupported block size %u\n", pPlan->blocksize);
+		ok = 0;
+	}
+	
+	if(ok)
+	{
+		convolver.fft.radix   = pPlan->radix;
+		convolver.doubleaccum = doubleaccum;
+		
+		for(c = 0; c < channels; c++)
+		{
+			tr_deinterleave(pInput, channelinput, channels, c, inputframes);
+			for(i = 0; i < pCount; i++)
+			{
+				responses[i] = &entries[i]->spectra[c];
+			}
+			
+			tr_convolver_reset(&convolver);
+			tr_convolve_fft_bus(&convolver, responses, pCount, weights, channelinput, inputframes, channeloutputs, framestotal);
+			
+			for(i = 0; i < outputs; i++)
+			{
+				tr_interleave(channeloutputs[i], outputbuffers[i], channels, c, framestotal[i]);
+			}
+		}
+		
+		tr_convolver_free(&convolver);
+	}
+	
+	for(i = 0; i < outputs && ok; i++)
+	{
+		char* filename;
+		if(mix)
+		{
+			filename = outfilename ? strdup(outfilename) : tr_output_filename(pInputName, "_mix.wav");
+		}
+		else if(outfilename)
+		{
+			filename = tr_numbered_filename(outfilename, i + 1);
+		}
+		else
+		{
+			filename = tr_output_filename(pInputName, pResponseNames[i]);
+		}
+		
+		ok = tr_write_output(filename, outputbuffers[i], framestotal[i] * channels, pInputWav);
+		free(filename);
+	}
+	
+	for(i = 0; i < outputs; i++)
+	{
+		if(outputbuffers)
+		{
+			free(outputbuffers[i]);
+		}
+		if(channeloutputs)
+		{
+			free(channeloutputs[i]);
+		}
+	}
+	free(outputbuffers);
+	free(channeloutputs);
+	free(responses);
+	free(channelinput);
+	free(weights);
+	free(framestotal);
+	free(entries);
+	tr_ircache_free(&cache);
+	return ok;
+}
+
+/**
+	Convolve block by block through a raw float file next to the output, then
+	normalise that into the wav.  Progress is checkpointed every checkpointinterval
+	seconds; the output only depends on the input, so a resumed render overwrites
+	whatever was written after the checkpoint and ends up byte identical.
+*/
+static int tr_render_stream(tr_wavfile* pInputWav, const float* pResponse, unsigned int pResponseFrames, const tr_plan* pPlan)
+{
+	unsigned int channels    = pInputWav->channels;
+	unsigned int inputframes = pInputWav->totalsamples / channels;
+	unsigned int totalframes = inputframes + pResponseFrames - 1;
+	unsigned int i;
+	
+	if(!checkpointfilename)
+	{
+		checkpointfilename = malloc(strlen(outfilename) + 12);
+		strcpy(checkpointfilename, outfilename);
+		strcat(checkpointfilename, ".checkpoint");
+	}
+	char* rawfilename = malloc(strlen(outfilename) + 9);
+	strcpy(rawfilename, outfilename);
+	strcat(rawfilename, ".partial");
+	
+	tr_checkpoint state;
+	state.channels       = channels;
+	state.samplerate     = pInputWav->samplerate;
+	state.inputframes    = inputframes;
+	state.responseframes = pResponseFrames;
+	state.blocksize      = pPlan->blocksize;
+	state.radix          = pPlan->radix;
+	state.precision      = irprecision;
+	state.doubleaccum    = doubleaccum;
+	state.response       = tr_incremental_hash(pResponse, pResponseFrames * channels);
+	state.phase          = TR_CHECKPOINT_CONVOLVE;
+	state.frames         = 0;
+	state.peak           = 0.0f;
+	
+	int ok = tr_input_hash(pInputWav, &state.input);
+	if(!ok)
+	{
+		fprintf(stderr, "ERROR: Failed reading input file\n");
+	}
+	
+	/* The plan of the interrupted render is kept, a measured plan could differ this time */
+	int resumed = 0;
+	if(ok && resume)
+	{
+		tr_checkpoint saved;
+		if(!tr_checkpoint_load(checkpointfilename, &saved, NULL))
+		{
+			if(!quiet)
+			{
+				fprintf(stdout, "No checkpoint in %s, starting from the beginning\n", checkpointfilename);
+			}
+		}
+		else if(!tr_checkpoint_matches(&saved, &state))
+		{
+			fprintf(stderr, "ERROR: Checkpoint %s belongs to a different render\n", checkpointfilename);
+			ok = 0;
+		}
+		else
+		{
+			state   = saved;
+			resumed = 1;
+		}
+	}
+	
+	unsigned int blocksize = state.blocksize;
+	tr_stream stream;
+	int streamready = 0;
+	if(ok)
+	{
+		streamready = tr_stream_init(&stream, pResponse, pResponseFrames, channels, blocksize, state.radix, irprecision, doubleaccum);
+		if(!streamready)
+		{
+			fprintf(stderr, "ERROR: Unsupported block size %u\n", blocksize);
+			ok = 0;
+		}
+	}
+	if(ok && resumed && !tr_checkpoint_load(checkpointfilename, &state, &stream))
+	{
+		fprintf(stderr, "ERROR: Failed reading checkpoint %s\n", checkpointfilename);
+		ok = 0;
+	}
+	
+	FILE* rawfile = NULL;
+	if(ok)
+	{
+		rawfile = fopen(rawfilename, resumed ? "r+b" : "w+b");
+		if(rawfile == 0)
+		{
+			fprintf(stderr, "ERROR: Failed opening %s\n", rawfilename);
+			ok = 0;
+		}
+	}
+	
+	float* inblock  = malloc(blocksize * channels * sizeof(float));
+	float* outblock = malloc(blocksize * channels * sizeof(float));
+	if(ok && (!inblock || !outblock))
+	{
+		fprintf(stderr, "ERROR: Not enough memory for blocks of %u\n", blocksize);
+		ok = 0;
+	}
+	
+	if(!quiet && ok)
+	{
+		if(resumed)
+		{
+			fprintf(stdout, "Resuming %s at %.2f seconds\n", state.phase == TR_CHECKPOINT_CONVOLVE ? "convolution" : "writing",
+			   (float)state.frames / state.samplerate);
+		}
+		fprintf(stdout, "Streaming in blocks of %u, checkpoints in %s\n", blocksize, checkpointfilename);
+	}
+	
+	double lastsave = tr_timer_seconds();
+	
+	if(ok && state.phase == TR_CHECKPOINT_CONVOLVE)
+	{
+		if(!quiet)
+		{
+			fprintf(stdout, "Processing audio, please be patient\n");
+		}
+		
+		tr_wavseek(pInputWav, state.frames * channels);
+		fseek(rawfile, (long int)state.frames * channels * sizeof(float), SEEK_SET);
+		
+		while(ok && state.frames < totalframes)
+		{
+			unsigned int count = state.frames < inputframes ? inputframes - state.frames : 0;
+			if(count > blocksize)
+			{
+				count = blocksize;
+			}
+			if(count > 0 && !tr_wavread(pInputWav, inblock, count * channels))
+			{
+				fprintf(stderr, "ERROR: Failed reading input file\n");
+				ok = 0;
+				break;
+			}
+			memset(inblock + count * channels, 0, (blocksize - count) * channels * sizeof(float));
+			
+			tr_stream_process(&stream, inblock, outblock);
+			
+			/* Only the last block is short, resumes always start on a block boundary */
+			unsigned int keep = totalframes - state.frames < blocksize ? totalframes - state.frames : blocksize;
+			for(i = 0; i < keep * channels; i++)
+			{
+				if(outblock[i] > state.peak)
+				{
+					state.peak = outblock[i];
+				}
+			}
+			if(fwrite(outblock, sizeof(float), keep * channels, rawfile) != keep * channels)
+			{
+				fprintf(stderr, "ERROR: Failed writing %s\n", rawfilename);
+				ok = 0;
+				break;
+			}
+			state.frames += keep;
+			
+			if(tr_timer_seconds() - lastsave >= checkpointinterval)
+			{
+				fflush(rawfile);
+				if( !tr_checkpoint_save(checkpointfilename, &state, &stream) )
+				{
+					fprintf(stderr, "WARNING: Failed writing checkpoint %s\n", checkpointfilename);
+				}
+				lastsave = tr_timer_seconds();
+			}
+		}
+		
+		if(ok)
+		{
+			state.phase  = TR_CHECKPOINT_WRITE;
+			state.frames = 0;
+			fflush(rawfile);
+			tr_checkpoint_save(checkpointfilename, &state, &stream);
+			lastsave = tr_timer_seconds();
+		}
+	}
+	
+	FILE* outfile = NULL;
+	if(ok)
+	{
+		/* A fresh wav is only started at the beginning of the phase, later the header is
+		   rewritten on close and the samples go after the ones already written */
+		tr_incremental_removeplan(outfilename);
+		outfile = fopen(outfilename, state.frames > 0 ? "r+b" : "wb");
+		if(outfile == 0)
+		{
+			fprintf(stderr, "ERROR: Failed opening output file %s\n", outfilename);
+			ok = 0;
+		}
+	}
+	
+	if(ok)
+	{
+		tr_wavfile outwav;
+		tr_wavopen(outfile, &outwav, 'w');
+		outwav.channels       = channels;
+		outwav.samplerate     = state.samplerate;
+		outwav.bytespersample = pInputWav->bytespersample;
+		outwav.totalsamples   = state.frames * channels;
+		if( !tr_wavreserve(&outwav, totalframes * channels, 0) )
+		{
+			fprintf(stderr, "ERROR: Failed during write of %s.  File may be malformed\n", outfilename);
+			ok = 0;
+		}
+		
+		if(!quiet && ok)
+		{
+			fprintf(stdout, "Normalising audio\n");
+			fprintf(stdout, "\n");
+			fprintf(stdout, "Output file        : %s\n", outfilename);
+			fprintf(stdout, "  Samples          : %u\n", totalframes * channels);
+			fprintf(stdout, "  Channels         : %i\n", outwav.channels);
+			fprintf(stdout, "  Sample rate      : %u\n", outwav.samplerate);
+			fprintf(stdout, "  Bytes per sample : %u\n", outwav.bytespersample);
+			fprintf(stdout, "  Duration seconds : %.2f\n", ((float)totalframes / (float)outwav.samplerate));
+			
+			fprintf(stdout, "\n");
+			fprintf(stdout, "Writing data out to %s\n", outfilename);
+		}
+		
+		float normalise = 1.0f / state.peak;
+		fseek(rawfile, (long int)state.frames * channels * sizeof(float), SEEK_SET);
+		
+		while(ok && state.frames < totalframes)
+		{
+			unsigned int count = totalframes - state.frames < blocksize ? totalframes - state.frames : blocksize;
+			if(fread(outblock, sizeof(float), count * channels, rawfile) != count * channels)
+			{
+				fprintf(stderr, "ERROR: Failed reading %s\n", rawfilename);
+				ok = 0;
+				break;
+			}
+			for(i = 0; i < count * channels; i++)
+			{
+				outblock[i] *= normalise;
+			}
+			if(!tr_wavwrite(&outwav, outblock, count * channels))
+			{
+				fprintf(stderr, "ERROR: Failed during write of %s.  File may be malformed\n", outfilename);
+				ok = 0;
+				break;
+			}
+			state.frames += count;
+			
+			if(tr_timer_seconds() - lastsave >= checkpointinterval)
+			{
+				/* A checkpoint must not count samples that never reached the output */
+				if( !tr_wavflush(&outwav) || fflush(outfile) != 0 )
+				{
+					fprintf(stderr, "ERROR: Failed during write of %s.  File may be malformed\n", outfilename);
+					ok = 0;
+					break;
+				}
+				if( !tr_checkpoint_save(checkpointfilename, &state, &stream) )
+				{
+					fprintf(stderr, "WARNING: Failed writing checkpoint %s\n", checkpointfilename);
+				}
+				lastsave = tr_timer_seconds();
+			}
+		}
+		
+		if(ok && !tr_wavflush(&outwav))
+		{
+			fprintf(stderr, "ERROR: Failed during write of %s.  File may be malformed\n", outfilename);
+			ok = 0;
+		}
+		int closed = tr_wavclose(&outwav);
+		if(fclose(outfile) != 0 || (ok && !closed))
+		{
+			fprintf(stderr, "ERROR: Failed finishing %s.  File may be malformed\n", outfilename);
+			ok = 0;
+		}
+	}
+	
+	if(rawfile)
+	{
+		fclose(rawfile);
+	}
+	if(ok)
+	{
+		remove(rawfilename);
+		remove(checkpointfilename);
+		tr_save_plan(outfilename, pResponse, pResponseFrames * channels, blocksize, state.radix);
+	}
+	
+	free(inblock);
+	free(outblock);
+	free(rawfilename);
+	if(streamready)
+	{
+		tr_stream_free(&stream);
+	}
+	return ok;
+}
+
 
-static void tr_parseoptions(int argc, char** argv)
+/**
+	Patch the spans of updatefilename that the changed input reaches.  The rest of the
+	file keeps its samples, so its gain has to be kept too: the old peak is found again
+	by re-convolving the blocks holding the loudest sample, which are untouched by the
+	edit.  The spans are convolved with the plan kept for the file, a measured plan
+	could differ this time.  When there is no plan, the settings or response changed,
+	or the edit removes that peak or goes above it the whole file would change, then -1
+	asks for a full render instead.  1 when patched, 0 on error.
+*/
+static int tr_render_update(tr_wavfile* pInputWav, const float* pResponse, unsigned int pResponseFrames)
 {
-	int option_index = 1;
-	int opt;
+	unsigned int channels    = pInputWav->channels;
+	unsigned int inputframes = pInputWav->totalsamples / channels;
+	unsigned int totalframes = inputframes + pResponseFrames - 1;
+	unsigned int i, s;
 	
-	while((opt = getopt_long(argc, argv, "vhso:", tr_long_options, &option_index)) != -1)
+	tr_incremental_plan saved;
+	if( !tr_incremental_loadplan(updatefilename, &saved) )
 	{
-		switch(opt)
+		if(!quiet)
 		{
-			case 'h':
-				tr_help();
-				exit(0);
-				break;
-			case 'v':
-				tr_version();
-				exit(0);
-				break;
-			case 's':
-				quiet = 1;
-				break;
-			case 'o':
-				outfilename = strdup(optarg);
+			fprintf(stdout, "%s has no plan kept with it, rendering in full\n", updatefilename);
+		}
+		return -1;
+	}
+	if(saved.precision != irprecision || saved.doubleaccum != doubleaccum
+	   || saved.response != tr_incremental_hash(pResponse, pResponseFrames * channels))
+	{
+		if(!quiet)
+		{
+			fprintf(stdout, "%s was rendered with another response or settings, rendering in full\n", updatefilename);
+		}
+		return -1;
+	}
+	
+	unsigned int blocksize = saved.blocksize;
+	tr_stream stream;
+	if( !tr_stream_init(&stream, pResponse, pResponseFrames, channels, blocksize, saved.radix, irprecision, doubleaccum) )
+	{
+		if(!quiet)
+		{
+			fprintf(stdout, "%s has an unusable plan, rendering in full\n", updatefilename);
+		}
+		return -1;
+	}
+	
+	FILE* previousfile = fopen(updatefilename, "r+b");
+	tr_wavfile previouswav;
+	if(previousfile == 0 || !tr_wavopen(previousfile, &previouswav, 'r'))
+	{
+		fprintf(stderr, "ERROR: Failed opening %s to update\n", updatefilename);
+		if(previousfile)
+		{
+			fclose(previousfile);
+		}
+		tr_stream_free(&stream);
+		return 0;
+	}
+	if(previouswav.channels != channels || previouswav.bytespersample != 2 || previouswav.bigendian
+	   || previouswav.totalsamples != totalframes * channels)
+	{
+		if(!quiet)
+		{
+			fprintf(stdout, "%s does not match the new render, rendering in full\n", updatefilename);
+		}
+		fclose(previousfile);
+		tr_stream_free(&stream);
+		return -1;
+	}
+	
+	/* Input that changed */
+	int result = 1;
+	tr_spans changed;
+	tr_spans_init(&changed);
+	for(i = 0; i < editcount; i++)
+	{
+		double end = edits[i * 2 + 1] * pInputWav->samplerate;
+		tr_spans_add(&changed, edits[i * 2] * pInputWav->samplerate, end < inputframes ? (unsigned int)end : inputframes);
+	}
+	if(originalfilename)
+	{
+		FILE* originalfile = fopen(originalfilename, "rb");
+		tr_wavfile originalwav;
+		if(originalfile == 0 || !tr_wavopen(originalfile, &originalwav, 'r'))
+		{
+			fprintf(stderr, "ERROR: Failed opening original input %s\n", originalfilename);
+			result = 0;
+		}
+		else if(originalwav.channels != channels || originalwav.totalsamples != pInputWav->totalsamples)
+		{
+			if(!quiet)
+			{
+				fprintf(stdout, "%s and the new input differ in length, rendering in full\n", originalfilename);
+			}
+			result = -1;
+		}
+		else if( !tr_incremental_diff(&originalwav, pInputWav, blocksize, &changed) )
+		{
+			fprintf(stderr, "ERROR: Failed comparing %s with the new input\n", originalfilename);
+			result = 0;
+		}
+		
+		if(originalfile)
+		{
+			fclose(originalfile);
+		}
+	}
+	
+	tr_spans affected;
+	tr_spans_init(&affected);
+	if(result == 1)
+	{
+		tr_incremental_affected(&changed, pResponseFrames, blocksize, totalframes, &affected);
+		
+		if(!quiet)
+		{
+			unsigned int framesaffected = 0;
+			for(s = 0; s < affected.count; s++)
+			{
+				framesaffected += affected.spans[s].end - affected.spans[s].start;
+			}
+			fprintf(stdout, "Changed input      : %u spans, %.2f of %.2f output seconds to render\n", changed.count,
+			   (float)framesaffected / pInputWav->samplerate, (float)totalframes / pInputWav->samplerate);
+		}
+	}
+	
+	/* Blocks holding the loudest sample of the previous output */
+	tr_spans loudest;
+	tr_spans_init(&loudest);
+	float loudestsample = 0.0f;
+	unsigned int pos;
+	
+	if(result == 1 && affected.count > 0)
+	{
+		float* block = malloc(blocksize * channels * sizeof(float));
+		for(pos = 0; pos < totalframes; pos += blocksize)
+		{
+			unsigned int count = totalframes - pos < blocksize ? totalframes - pos : blocksize;
+			if( !tr_wavread(&previouswav, block, count * channels) )
+			{
+				fprintf(stderr, "ERROR: Failed reading %s\n", updatefilename);
+				result = 0;
 				break;
-			default:
-				fprintf(stderr, "ERROR: Invalid argument. Use -h for help \n");
-				exit(1); /* We probably could survive, better to just bail for now; at least that way we can guarentee nothing bad will happen */
+			}
+			
+			float blockmax = 0.0f;
+			for(i = 0; i < count * channels; i++)
+			{
+				if(block[i] > blockmax)
+				{
+					blockmax = block[i];
+				}
+			}
+			if(blockmax > loudestsample)
+			{
+				loudestsample = blockmax;
+				tr_spans_free(&loudest);
+			}
+			if(blockmax == loudestsample)
+			{
+				tr_spans_add(&loudest, pos, pos + count);
+			}
+		}
+		free(block);
+	}
+	
+	float peak = 0.0f;
+	float** rendered = calloc(affected.count ? affected.count : 1, sizeof(float*));
+	
+	for(s = 0; s < loudest.count && result == 1 && affected.count > 0; s++)
+	{
+		if(tr_spans_overlap(&affected, loudest.spans[s].start, loudest.spans[s].end))
+		{
+			result = -1;
+			break;
+		}
+		
+		unsigned int frames = loudest.spans[s].end - loudest.spans[s].start;
+		float* output = malloc(frames * channels * sizeof(float));
+		result = tr_incremental_render(&stream, pInputWav, inputframes, loudest.spans[s].start, loudest.spans[s].end, output);
+		for(i = 0; i < frames * channels; i++)
+		{
+			if(output[i] > peak)
+			{
+				peak = output[i];
+			}
+		}
+		free(output);
+		if(result == 0)
+		{
+			fprintf(stderr, "ERROR: Failed reading input file\n");
+		}
+	}
+	
+	for(s = 0; s < affected.count && result == 1; s++)
+	{
+		unsigned int frames = affected.spans[s].end - affected.spans[s].start;
+		rendered[s] = malloc(frames * channels * sizeof(float));
+		result = tr_incremental_render(&stream, pInputWav, inputframes, affected.spans[s].start, affected.spans[s].end, rendered[s]);
+		if(result == 0)
+		{
+			fprintf(stderr, "ERROR: Failed reading input file\n");
+		}
+		for(i = 0; i < frames * channels && result == 1; i++)
+		{
+			if(rendered[s][i] > peak)
+			{
+				result = -1;
+			}
+		}
+	}
+	
+	if(result == -1 && affected.count > 0 && !quiet)
+	{
+		fprintf(stdout, "The edit changes the peak of %s, rendering in full\n", updatefilename);
+	}
+	else if(result == 1 && affected.count > 0)
+	{
+		if(!quiet)
+		{
+			fprintf(stdout, "Writing %u spans into %s\n", affected.count, updatefilename);
+		}
+		
+		/* The header stays as it is, each span is written over its old samples */
+		float normalise = 1.0f / peak;
+		for(s = 0; s < affected.count; s++)
+		{
+			unsigned int samples = (affected.spans[s].end - affected.spans[s].start) * channels;
+			for(i = 0; i < samples; i++)
+			{
+				rendered[s][i] *= normalise;
+			}
+			
+			tr_wavfile patch = previouswav;
+			patch.totalsamples = affected.spans[s].start * channels;
+			if(!tr_wavwrite(&patch, rendered[s], samples))
+			{
+				fprintf(stderr, "ERROR: Failed during write of %s.  File may be malformed\n", updatefilename);
+				result = 0;
 				break;
+			}
 		}
 	}
+	
+	for(s = 0; s < affected.count; s++)
+	{
+		free(rendered[s]);
+	}
+	free(rendered);
+	tr_stream_free(&stream);
+	tr_spans_free(&loudest);
+	tr_spans_free(&affected);
+	tr_spans_free(&changed);
+	if(fclose(previousfile) != 0 && result == 1)
+	{
+		fprintf(stderr, "ERROR: Failed during write of %s.  File may be malformed\n", updatefilename);
+		result = 0;
+	}
+	return result;
 }
 
 
@@ -123,34 +1914,49 @@ int main(int argc, char** argv)
 		tr_version();
 	}
 	
+	if(merge)
+	{
+		if(!outfilename)
+		{
+			fprintf(stderr, "ERROR: --merge needs the output filename the shards were rendered for. Use -h for help \n");
+			return 1;
+		}
+		return tr_merge_shards() ? 0 : 1;
+	}
+	
 	if(argc - optind < 2)
 	{
 		fprintf(stderr, "ERROR: Requires input and response file to be specified. Use -h for help \n");
 		return 1;
 	}
 	
+	if(album)
+	{
+		if(automationfilename || multirate || checkpoint || updatefilename || shardcount || realtimeblock || mix)
+		{
+			fprintf(stderr, "ERROR: --album can not be combined with --automation, --multirate, --checkpoint, --update, --shard, --realtime-sim or --mix\n");
+			return 1;
+		}
+		if(enginechosen && engine != TR_ENGINE_FFT)
+		{
+			fprintf(stderr, "ERROR: --album runs the fft engine, it can not be combined with --engine=direct or sparse\n");
+			return 1;
+		}
+		return tr_render_album(argv + optind, argc - optind - 1, argv[argc - 1]) ? 0 : 1;
+	}
+	
 	
 	const char* infilename       = argv[optind];
 	const char* responsefilename = argv[optind+1];
+	unsigned int responsecount   = argc - optind - 1;  /* more than one makes a send bus */
 	
 	/* Make a filename from the input and response names */
-	if(!outfilename)
+	if(!outfilename && responsecount == 1)
 	{
-		char* innameend = strrchr(infilename, '.');
-		int innamelen = innameend ? innameend-infilename : strlen(infilename);
-		
-		char* responsenameend = strrchr(responsefilename, '.');
-		int responsenamelen = responsenameend ? responsenameend-responsefilename : strlen(responsefilename);
-		
-		outfilename = malloc(innamelen+responsenamelen + 5); /* + '.wav '*/
-		strncpy(outfilename, infilename, innamelen);
-		strncat(outfilename, responsefilename, responsenamelen);
-		strcat(outfilename, ".wav");
+		outfilename = tr_output_filename(infilename, responsefilename);
 	}
 	
 	
-	InitEndian();
-	
 	/* Setup the input file */
 	FILE* infile = fopen(infilename, "rb");
 	if(infile == 0)
@@ -218,19 +2024,68 @@ int main(int argc, char** argv)
 		   infilename, inputwav.samplerate, responsefilename, responsewav.samplerate);
 		return 1;
 	}
-	else if(!quiet)
+	else if(checkpoint && (automationfilename || multirate))
 	{
-		fprintf(stdout, "Reading %s and %s into memory\n", infilename, responsefilename);
+		fprintf(stderr, "ERROR: --checkpoint can not be combined with --automation or --multirate\n");
+		return 1;
 	}
-	
-	/* Both are open, now read them into memory */
-	float* inputbuffer = malloc(inputwav.totalsamples * sizeof(float));
-	if( !tr_wavread(&inputwav, inputbuffer, inputwav.totalsamples) )
+	else if(updatefilename && (automationfilename || multirate || checkpoint))
 	{
-		fprintf(stderr, "ERROR: Failed reading input file\n");
+		fprintf(stderr, "ERROR: --update can not be combined with --automation, --multirate or --checkpoint\n");
+		return 1;
+	}
+	else if(responsecount > 1 && (automationfilename || multirate || checkpoint || updatefilename))
+	{
+		fprintf(stderr, "ERROR: Several responses can not be combined with --automation, --multirate, --checkpoint or --update\n");
+		return 1;
+	}
+	else if(shardcount && (automationfilename || multirate || checkpoint || updatefilename || responsecount > 1))
+	{
+		fprintf(stderr, "ERROR: --shard can not be combined with --automation, --multirate, --checkpoint, --update or several responses\n");
+		return 1;
+	}
+	else if(realtimeblock && (automationfilename || multirate || checkpoint || updatefilename || responsecount > 1 || shardcount))
+	{
+		fprintf(stderr, "ERROR: --realtime-sim can not be combined with --automation, --multirate, --checkpoint, --update, --shard or several responses\n");
+		return 1;
+	}
+	else if(realtimeblock && enginechosen && engine != TR_ENGINE_FFT)
+	{
+		fprintf(stderr, "ERROR: --realtime-sim runs the fft engine, it can not be combined with --engine=direct or sparse\n");
+		return 1;
+	}
+	else if((automationfilename || checkpoint || updatefilename || shardcount || responsecount > 1) && enginechosen && engine != TR_ENGINE_FFT)
+	{
+		fprintf(stderr, "ERROR: --automation, --checkpoint, --update, --shard and several responses run the fft engine, they can not be combined with --engine=direct or sparse\n");
+		return 1;
+	}
+	else if((analysis || loudnessnormalise) && (checkpoint || shardcount || updatefilename))
+	{
+		fprintf(stderr, "ERROR: --analysis and --loudness can not be combined with --checkpoint, --shard or --update\n");
+		return 1;
+	}
+	else if(analysisfilename && strcmp(analysisfilename, "-") != 0 && responsecount > 1 && !mix)
+	{
+		fprintf(stderr, "ERROR: Several outputs need a report each, use --analysis without a filename\n");
+		return 1;
+	}
+	else if(mix && responsecount == 1)
+	{
+		fprintf(stderr, "ERROR: --mix needs several responses to sum\n");
+		return 1;
+	}
+	else if(mixweightcount > responsecount)
+	{
+		fprintf(stderr, "ERROR: %u mix weights for %u responses\n", mixweightcount, responsecount);
+		return 1;
+	}
+	else if(updatefilename && !originalfilename && editcount == 0)
+	{
+		fprintf(stderr, "ERROR: --update needs --original or --edit to know what changed\n");
 		return 1;
 	}
 	
+	/* The response is always read into memory, the input only when not streaming */
 	float* responsebuffer = malloc(responsewav.totalsamples * sizeof(float));
 	if(!tr_wavread(&responsewav, responsebuffer, responsewav.totalsamples))
 	{
@@ -239,103 +2094,397 @@ int main(int argc, char** argv)
 	}
 	
 	/* Prepare a buffer to accept the data from our processing */
-	unsigned int samplesinput    = inputwav.totalsamples;
-	unsigned int samplesresponse = responsewav.totalsamples;
-	unsigned int samplestotal    = samplesinput + samplesresponse + 1;
-	float* outputbuffer = malloc(samplestotal*sizeof(float));
+	unsigned int channels        = inputwav.channels;
+	unsigned int framesinput     = inputwav.totalsamples / channels;
+	unsigned int framesresponse  = responsewav.totalsamples / channels;
+	unsigned int framestotal     = framesinput + framesresponse - 1;
 	
-	float* conv = outputbuffer;
-	unsigned int inoffset;
-	unsigned int reoffset;
-	unsigned int n_hi;
-	unsigned int n_lo;
+	/* A send bus is planned for its longest response */
+	unsigned int framesplan = framesresponse;
+	unsigned int r;
+	for(r = 1; r < responsecount; r++)
+	{
+		FILE* file = fopen(argv[optind+1+r], "rb");
+		tr_wavfile wav;
+		if(file && tr_wavopen(file, &wav, 'r') && wav.channels == channels && wav.totalsamples / channels > framesplan)
+		{
+			framesplan = wav.totalsamples / channels;
+		}
+		if(file)
+		{
+			fclose(file);
+		}
+	}
 	
-	if(!quiet)
+	/* Block size and radix of the fft engine */
+	tr_plan plan;
+	plan.blocksize = tr_convolver_blocksize(framesplan);
+	plan.radix     = 4;
+	if(engine != TR_ENGINE_DIRECT || automationfilename || checkpoint || updatefilename || responsecount > 1 || shardcount)
 	{
-		fprintf(stdout, "Processing audio, please be patient\n");
+		if(!quiet && planmode != TR_PLAN_ESTIMATE)
+		{
+			fprintf(stdout, "Measuring fft plans\n");
+		}
+		tr_planner_plan(&plan, framesplan, channels, planmode, wisdomfilename);
+		
+		if(!quiet)
+		{
+			fprintf(stdout, "FFT plan           : block size %u, radix %u%s\n", plan.blocksize, plan.radix,
+			   plan.measured == 1 ? ", measured" : plan.measured == 2 ? ", from wisdom" : "");
+			fprintf(stdout, "\n");
+		}
 	}
+	unsigned int blocksize       = plan.blocksize;
 	
-	/* Do the processing (time domain convolution) */
-	unsigned int i;
-	for(i = 0; i < samplestotal; i++)
+	if(checkpoint)
 	{
-		n_lo = i < samplesresponse ? 0 : i - samplesresponse;
-		n_hi = samplesinput < i ? samplesinput : i;
+		int ok = tr_render_stream(&inputwav, responsebuffer, framesresponse, &plan);
 		
-		inoffset = n_lo;
-		reoffset = i - n_lo;
+		free(responsebuffer);
+		tr_wavclose(&inputwav);
+		tr_wavclose(&responsewav);
+		fclose(infile);
+		fclose(responsefile);
+		return ok ? 0 : 1;
+	}
+	
+	if(shardcount)
+	{
+		int ok = tr_render_shard(&inputwav, responsebuffer, framesresponse, &plan);
 		
-		*conv = 0.0f;
-		unsigned int n;
-		for(n = n_lo; n < n_hi; n++)
+		free(responsebuffer);
+		tr_wavclose(&inputwav);
+		tr_wavclose(&responsewav);
+		fclose(infile);
+		fclose(responsefile);
+		return ok ? 0 : 1;
+	}
+	
+	if(updatefilename)
+	{
+		int updated = tr_render_update(&inputwav, responsebuffer, framesresponse);
+		if(updated >= 0)
 		{
-			*conv += *(inputbuffer+inoffset) * *(responsebuffer+reoffset);
-			++inoffset;
-			--reoffset;
+			free(responsebuffer);
+			tr_wavclose(&inputwav);
+			tr_wavclose(&responsewav);
+			fclose(infile);
+			fclose(responsefile);
+			return updated ? 0 : 1;
 		}
-		conv++;
+		
+		/* The patch could not be made, render it all over the previous output */
+		engine      = TR_ENGINE_FFT;
+		outfilename = updatefilename;
+		tr_wavseek(&inputwav, 0);
 	}
 	
 	if(!quiet)
 	{
-		fprintf(stdout, "Normalising audio\n");
+		fprintf(stdout, "Reading %s into memory\n", infilename);
 	}
 	
-	/* Normalise the data */
-	conv = outputbuffer;
-	float maxsample = 0.0f;
+	float* inputbuffer = malloc(inputwav.totalsamples * sizeof(float));
+	if( !tr_wavread(&inputwav, inputbuffer, inputwav.totalsamples) )
+	{
+		fprintf(stderr, "ERROR: Failed reading input file\n");
+		return 1;
+	}
+	
+	if(realtimeblock)
+	{
+		int ok = tr_render_realtime(&inputwav, inputbuffer, responsebuffer, framesresponse, &plan);
+		
+		free(inputbuffer);
+		free(responsebuffer);
+		tr_wavclose(&inputwav);
+		tr_wavclose(&responsewav);
+		fclose(infile);
+		fclose(responsefile);
+		return ok ? 0 : 1;
+	}
+	
+	if(responsecount > 1)
+	{
+		int ok = tr_render_bus(&inputwav, infilename, inputbuffer, argv + optind + 1, responsecount, &plan);
+		
+		free(inputbuffer);
+		free(responsebuffer);
+		tr_wavclose(&inputwav);
+		tr_wavclose(&responsewav);
+		fclose(infile);
+		fclose(responsefile);
+		return ok ? 0 : 1;
+	}
 	
-	for(i = 0; i < samplestotal; i++)
+	/* Every response of the automation is transformed up front, repeats come from the cache */
+	tr_automation automation;
+	tr_ircache cache;
+	const tr_ircache_entry** automationentries = NULL;
+	unsigned int partitions = (framesresponse + blocksize - 1) / blocksize;
+	
+	if(automationfilename)
 	{
-		if(*conv > maxsample)
+		if( !tr_automation_load(&automation, automationfilename, responsefilename, inputwav.samplerate) )
+		{
+			fprintf(stderr, "ERROR: Failed reading automation file %s\n", automationfilename);
+			return 1;
+		}
+		
+		if( !tr_ircache_init(&cache, blocksize, irprecision) )
+		{
+			fprintf(stderr, "ERROR: Unsupported block size %u\n", blocksize);
+			return 1;
+		}
+		cache.fft.radix = plan.radix;
+		automationentries = malloc(automation.count * sizeof(tr_ircache_entry*));
+		
+		unsigned int e;
+		for(e = 0; e < automation.count; e++)
+		{
+			const tr_ircache_entry* entry = tr_ircache_get(&cache, automation.events[e].filename);
+			if(!entry)
+			{
+				fprintf(stderr, "ERROR: Failed loading response %s\n", automation.events[e].filename);
+				return 1;
+			}
+			else if(entry->channels != channels || entry->samplerate != inputwav.samplerate)
+			{
+				fprintf(stderr, "ERROR: %s does not match the channels and sample rate of %s\n", entry->filename, infilename);
+				return 1;
+			}
+			
+			if(framesinput + entry->frames - 1 > framestotal)
+			{
+				framestotal = framesinput + entry->frames - 1;
+			}
+			if(entry->spectra[0].partitions > partitions)
+			{
+				partitions = entry->spectra[0].partitions;
+			}
+			automationentries[e] = entry;
+		}
+		
+		if(!quiet)
 		{
-			maxsample = *conv;
+			fprintf(stdout, "Automation         : %s\n", automationfilename);
+			fprintf(stdout, "  Events           : %u\n", automation.count - 1);
+			fprintf(stdout, "\n");
 		}
-		++conv;
 	}
 	
-	conv = outputbuffer;
-	float normalise = 1.0f / maxsample;
+	unsigned int samplestotal    = framestotal * channels;
+	float* outputbuffer = malloc(samplestotal*sizeof(float));
 	
-	for(i = 0; i < samplestotal; i++)
+	/* Each channel is convolved on its own */
+	float* channelinput    = malloc(framesinput * sizeof(float));
+	float* channelresponse = malloc(framesresponse * sizeof(float));
+	float* channeloutput   = malloc(framestotal * sizeof(float));
+	
+	if(!quiet)
 	{
-		*conv++ *= normalise;
+		fprintf(stdout, "Processing audio, please be patient\n");
 	}
 	
-	/* Setup the output file */
-	FILE* outfile = fopen(outfilename, "wb");
-	if(outfile == 0)
+	/* Wide layouts go through the fft engine in batches, one channel per vector lane,
+	   channels left over are convolved one at a time below.  A render over an output
+	   that could not be updated stays per channel, so the next update can patch it, and
+	   a measured plan is kept rather than traded for the bigger blocks batching wants. */
+	unsigned int c = 0;
+	int batched = 0;
+	unsigned int batchblock = tr_batch_blocksize(blocksize, framesresponse);
+	if(plan.measured && batchblock != blocksize)
 	{
-		fprintf(stderr, "ERROR: Failed opening output file %s\n", outfilename);
-		return 1;
+		batchblock = 0;
+	}
+	if(engine == TR_ENGINE_FFT && !automationfilename && !multirate && !doubleaccum && irprecision == TR_IRSPECTRA_FLOAT && batchblock
+	   && !updatefilename)
+	{
+		unsigned int batchpartitions = (framesresponse + batchblock - 1) / batchblock;
+		unsigned int lanes;
+		while((lanes = tr_batch_lanes(channels - c)) > 0)
+		{
+			char range[24];
+			snprintf(range, sizeof(range), "%u-%u", c, c + lanes - 1);
+			
+			tr_batch_convolver batch;
+			tr_batch_spectra spectra;
+			if( !tr_batch_convolver_init(&batch, batchblock, batchpartitions, lanes) )
+			{
+				fprintf(stderr, "WARNING: Not enough memory to batch channels %s, convolving them one at a time\n", range);
+				break;
+			}
+			batch.fft.tables.radix = plan.radix;
+			if( !tr_batch_spectra_init(&spectra, &batch.fft, responsebuffer, channels, c, framesresponse) )
+			{
+				fprintf(stderr, "WARNING: Not enough memory to batch channels %s, convolving them one at a time\n", range);
+				tr_batch_convolver_free(&batch);
+				break;
+			}
+			int convolved = tr_convolve_fft_batch(&batch, &spectra, inputbuffer, channels, c, framesinput, outputbuffer, framestotal);
+			tr_batch_spectra_free(&spectra);
+			tr_batch_convolver_free(&batch);
+			if(!convolved)
+			{
+				fprintf(stderr, "WARNING: Not enough memory to batch channels %s, convolving them one at a time\n", range);
+				break;
+			}
+			
+			if(!quiet && batchblock != blocksize)
+			{
+				fprintf(stdout, "  Channels %-8s: batched, block size %u instead of the planned %u\n", range, batchblock, blocksize);
+			}
+			else if(!quiet)
+			{
+				fprintf(stdout, "  Channels %-8s: batched, block size %u\n", range, batchblock);
+			}
+			c += lanes;
+			batched = 1;
+		}
 	}
 	
-	tr_wavfile outwav;
-	tr_wavopen(outfile, &outwav, 'w');
-	outwav.channels       = inputwav.channels;
-	outwav.samplerate     = inputwav.samplerate;
-	outwav.bytespersample = inputwav.bytespersample;
-	
-	if(!quiet)
+	for(; c < channels; c++)
 	{
-		fprintf(stdout, "\n");
-		fprintf(stdout, "Output file        : %s\n", outfilename);
-		fprintf(stdout, "  Samples          : %u\n", samplestotal);
-		fprintf(stdout, "  Channels         : %i\n", outwav.channels);
-		fprintf(stdout, "  Sample rate      : %u\n", outwav.samplerate);
-		fprintf(stdout, "  Bytes per sample : %u\n", outwav.bytespersample);
-		fprintf(stdout, "  Duration seconds : %.2f\n", ((float)samplestotal / (float)outwav.samplerate / (float)outwav.channels));
+		tr_deinterleave(inputbuffer, channelinput, channels, c, framesinput);
+		tr_deinterleave(responsebuffer, channelresponse, channels, c, framesresponse);
 		
-		fprintf(stdout, "\n");
-		fprintf(stdout, "Writing data out to %s\n", outfilename);
+		if(automationfilename)
+		{
+			const tr_irspectra** responses = malloc(automation.count * sizeof(tr_irspectra*));
+			unsigned int e;
+			for(e = 0; e < automation.count; e++)
+			{
+				responses[e] = &automationentries[e]->spectra[c];
+			}
+			
+			tr_convolver convolver;
+			if( !tr_convolver_init(&convolver, blocksize, partitions) )
+			{
+				fprintf(stderr, "ERROR: Unsupported block size %u\n", blocksize);
+				return 1;
+			}
+			convolver.fft.radix   = plan.radix;
+			convolver.doubleaccum = doubleaccum;
+			tr_automation_render(&automation, responses, &convolver, channelinput, framesinput, channeloutput, framestotal,
+			   fade * inputwav.samplerate / 1000.0f);
+			tr_convolver_free(&convolver);
+			free(responses);
+		}
+		else if(multirate)
+		{
+			/* A crossover past the end of the response leaves it all at full rate */
+			double crossoverframes = (double)crossover * inputwav.samplerate / 1000.0;
+			tr_multirate plan;
+			tr_multirate_plan(&plan, channelresponse, framesresponse, crossoverframes < framesresponse ? (unsigned int)crossoverframes : framesresponse,
+			   multirateerror);
+			plan.doubleaccum = doubleaccum;
+			
+			if(!quiet)
+			{
+				if(plan.factor > 1)
+				{
+					fprintf(stdout, "  Channel %u        : tail from %.1fms at 1/%u rate, error %.1fdB\n",
+					   c, plan.crossover * 1000.0f / inputwav.samplerate, plan.factor, plan.error);
+				}
+				else
+				{
+					fprintf(stdout, "  Channel %u        : full rate\n", c);
+				}
+			}
+			tr_multirate_convolve(&plan, channelinput, framesinput, channelresponse, framesresponse, channeloutput);
+		}
+		else if(engine == TR_ENGINE_FFT)
+		{
+			tr_convolver convolver;
+			tr_irspectra spectra;
+			if( !tr_convolver_init(&convolver, blocksize, partitions) )
+			{
+				fprintf(stderr, "ERROR: Unsupported block size %u\n", blocksize);
+				return 1;
+			}
+			convolver.fft.radix   = plan.radix;
+			convolver.doubleaccum = doubleaccum;
+			if( !tr_irspectra_init(&spectra, &convolver.fft, channelresponse, framesresponse, irprecision) )
+			{
+				fprintf(stderr, "ERROR: Out of memory transforming the response\n");
+				return 1;
+			}
+			tr_convolve_fft(&convolver, &spectra, channelinput, framesinput, channeloutput, framestotal);
+			tr_irspectra_free(&spectra);
+			tr_convolver_free(&convolver);
+		}
+		else if(engine == TR_ENGINE_SPARSE)
+		{
+			tr_sparse sparse;
+			if( !tr_sparse_plan(&sparse, channelresponse, framesresponse, blocksize, sparsefloor < 0.0f ? pow(10.0, sparsefloor / 20.0) : 0.0f) )
+			{
+				fprintf(stderr, "ERROR: Out of memory planning the sparse response\n");
+				return 1;
+			}
+			
+			if(!quiet && sparse.split == 0)
+			{
+				fprintf(stdout, "  Channel %u        : no sparse early part, %u partitions as the fft engine\n",
+				   c, sparse.partitions);
+			}
+			else if(!quiet)
+			{
+				fprintf(stdout, "  Channel %u        : %u taps in the first %.1fms, %u tail partitions\n",
+				   c, sparse.taps, sparse.split * 1000.0f / inputwav.samplerate, sparse.partitions);
+			}
+			
+			tr_convolver convolver;
+			if( !tr_convolver_init(&convolver, blocksize, sparse.partitions ? sparse.partitions : 1) )
+			{
+				fprintf(stderr, "ERROR: Unsupported block size %u\n", blocksize);
+				tr_sparse_free(&sparse);
+				return 1;
+			}
+			convolver.fft.radix   = plan.radix;
+			convolver.doubleaccum = doubleaccum;
+			int convolved = tr_sparse_convolve(&sparse, &convolver, irprecision, channelinput, framesinput, channelresponse, framesresponse,
+			   channeloutput, framestotal);
+			tr_convolver_free(&convolver);
+			tr_sparse_free(&sparse);
+			if(!convolved)
+			{
+				fprintf(stderr, "ERROR: Out of memory transforming the response\n");
+				return 1;
+			}
+		}
+		else if(doubleaccum)
+		{
+			tr_convolve_direct_double(channelinput, framesinput, channelresponse, framesresponse, channeloutput);
+		}
+		else
+		{
+			/* Do the processing (time domain convolution) */
+			tr_convolve_direct(channelinput, framesinput, channelresponse, framesresponse, channeloutput);
+		}
+		
+		tr_interleave(channeloutput, outputbuffer, channels, c, framestotal);
 	}
 	
-	/* Write out data from the processing to file */
-	if(!tr_wavwrite(&outwav, outputbuffer, samplestotal))
+	free(channelinput);
+	free(channelresponse);
+	free(channeloutput);
+	
+	if(automationfilename)
 	{
-		fprintf(stderr, "ERROR: Failed during write of %s.  File may be malformed\n", outfilename);
+		free(automationentries);
+		tr_ircache_free(&cache);
+		tr_automation_free(&automation);
 	}
-
+	
+	int written = tr_write_output(outfilename, outputbuffer, samplestotal, &inputwav);
+	
+	/* Only the plain fft engine, convolving every channel with the plan, can be patched later */
+	if(written && engine == TR_ENGINE_FFT && !automationfilename && !multirate && !batched)
+	{
+		tr_save_plan(outfilename, responsebuffer, responsewav.totalsamples, blocksize, plan.radix);
+	}
+	
 	/* Clean up */
 	free(inputbuffer);
 	free(responsebuffer);
@@ -343,13 +2492,11 @@ int main(int argc, char** argv)
 	
 	tr_wavclose(&inputwav);
 	tr_wavclose(&responsewav);
-	tr_wavclose(&outwav);
 	
 	fclose(infile);
 	fclose(responsefile);
-	fclose(outfile);
 	
-	return 0;
+	return written ? 0 : 1;
 }
 
 #ifdef __cplusplus
@@ -19,56 +19,75 @@
     along with Trillian.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#define _GNU_SOURCE  /* O_DIRECT and fallocate */
+
 #include "wavfile.h"
 #include "endian.h"
 
 #include <string.h>
 #include <stdlib.h>
 
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
-static const unsigned long  WAV_RIFF        = 0x52494646; /* "riff" */
-static const unsigned long  WAV_FMT_WAVE    = 0x57415645; /* "wave" */
-static const unsigned long  WAV_FMT         = 0x666d7420; /* "fmt " */
-static const unsigned long  WAV_DATA        = 0x64617461; /* "data" */
-static const unsigned long  WAV_PCMCNK_SIZE = 16;
-static const unsigned short WAV_PCM         = 1;
+static const uint32_t WAV_RIFF        = 0x52494646; /* "riff" */
+static const uint32_t WAV_RIFX        = 0x52494658; /* "rifx", big endian riff */
+static const uint32_t WAV_FMT_WAVE    = 0x57415645; /* "wave" */
+static const uint32_t WAV_FMT         = 0x666d7420; /* "fmt " */
+static const uint32_t WAV_DATA        = 0x64617461; /* "data" */
+static const uint32_t WAV_PCMCNK_SIZE = 16;
+static const uint16_t WAV_PCM         = 1;
+
+/* Fields in the byte order of the file */
+#define WAV_U16(pWav, pVar)  ((pWav)->bigendian ? BigU16(pVar) : LittleU16(pVar))
+#define WAV_U32(pWav, pVar)  ((pWav)->bigendian ? BigU32(pVar) : LittleU32(pVar))
 
 
 static int  tr_iswav(tr_wavfile* pWav);
-static int  tr_findwavchunk(unsigned int pCnkID, FILE* pFile, long int* pCnkPos);
+static int  tr_findwavchunk(tr_wavfile* pWav, uint32_t pCnkID, long int* pCnkPos);
 static int  tr_wavreadfmt(tr_wavfile* pWav);
 static int  tr_wavreaddata(tr_wavfile* pWav);
-static void tr_wavwriteheaders(tr_wavfile* pWav);
+static int  tr_wavwriteheaders(tr_wavfile* pWav);
+static void tr_wavheader(const tr_wavfile* pWav, unsigned int pNumSamples, unsigned char* pDest);
+static int  tr_wavwriteat(tr_wavfile* pWav, const void* pData, size_t pCount, long int pOffset);
+static int  tr_wavwritebuffered(tr_wavfile* pWav, float* pBuffer, unsigned int pNumSamples);
+static void tr_wavsetdirect(tr_wavfile* pWav, int pDirect);
+static int  tr_wavtruncate(tr_wavfile* pWav, long int pLength);
 
 static void tr_convert_pcm16_float(signed short int* pPCMData, float* pOutput, unsigned int pNumSamples);
 static void tr_convert_float_pcm16(float* pFloatData, signed short int* pOutput, unsigned int pNumSamples);
 
 typedef struct
 {
-	unsigned long riffID;
-	unsigned long filesize;
-	unsigned long fmt;
+	uint32_t riffID;
+	uint32_t filesize;
+	uint32_t fmt;
 } tr_wavfile_riff;
 
 typedef struct
 {
-	unsigned long      fmtID;
-	unsigned long      chunksize;
-	unsigned short int format;
-	unsigned short int numchannels;
-	unsigned long      samplerate;
-	unsigned long      byterate;
-	unsigned short int blockalign;
-	unsigned short int bitspersample;
+	uint32_t fmtID;
+	uint32_t chunksize;
+	uint16_t format;
+	uint16_t numchannels;
+	uint32_t samplerate;
+	uint32_t byterate;
+	uint16_t blockalign;
+	uint16_t bitspersample;
 } tr_wavfile_fmt;
 
 typedef struct
 {
-	unsigned long cnkID;
-	unsigned long cnksize;
+	uint32_t cnkID;
+	uint32_t cnksize;
 } tr_wavfile_cnkheader;
 
 
@@ -77,6 +96,14 @@ int tr_wavopen(FILE* pFile, tr_wavfile* pWav, unsigned char pMode)
 	pWav->filehandle = pFile;
 	fseek(pWav->filehandle, 0, SEEK_SET);
 	pWav->mode = pMode;
+	pWav->bigendian = 0;
+	pWav->readpos = 0;
+	pWav->reserved    = 0;
+	pWav->writememory = NULL;
+	pWav->writebuffer = NULL;
+	pWav->writeoffset = 0;
+	pWav->writefill   = 0;
+	pWav->direct      = 0;
 	
 	switch(pMode)
 	{
@@ -96,6 +123,7 @@ int tr_wavopen(FILE* pFile, tr_wavfile* pWav, unsigned char pMode)
 		pWav->samplerate     = 44100;
 		pWav->bytespersample = 2;
 		pWav->channels       = 1;
+		pWav->totalsamples   = 0;
 		pWav->datastartpos   = sizeof(tr_wavfile_riff) + sizeof(tr_wavfile_fmt) + sizeof(tr_wavfile_cnkheader);
 		break;
 	default:
@@ -105,24 +133,46 @@ int tr_wavopen(FILE* pFile, tr_wavfile* pWav, unsigned char pMode)
 	return 0;
 }
 
-void tr_wavclose(tr_wavfile* pWav)
+int tr_wavclose(tr_wavfile* pWav)
 {
+	int ok = 1;
 	switch(pWav->mode)
 	{
 	case 'w':
-		tr_wavwriteheaders(pWav);
+		if(pWav->writememory)
+		{
+			ok = tr_wavflush(pWav);
+			free(pWav->writememory);
+			pWav->writememory = NULL;
+			pWav->writebuffer = NULL;
+			
+			/* The header written up front holds unless fewer samples came than announced,
+			   trimming the preallocation is tidying and a file that refuses it is still whole */
+			if(pWav->totalsamples == pWav->reserved)
+			{
+				tr_wavtruncate(pWav, pWav->datastartpos + (long int)pWav->totalsamples * sizeof(signed short));
+				break;
+			}
+		}
+		ok = tr_wavwriteheaders(pWav) && ok;
 		break;
 	default:
 		break;
 	}
+	return ok;
 }
 
 int tr_wavread(tr_wavfile* pWav, float* pBuffer, unsigned int pNumSamples)
 {
 	signed short int* readbuffer = malloc(pNumSamples * pWav->bytespersample);
-	fseek(pWav->filehandle, pWav->datastartpos, SEEK_SET);
+	fseek(pWav->filehandle, pWav->datastartpos + (long int)pWav->readpos * pWav->bytespersample, SEEK_SET);
 	size_t readCount = fread(readbuffer, pWav->bytespersample, pNumSamples, pWav->filehandle);
+	pWav->readpos += readCount;
 	
+	if(pWav->bigendian != TR_HOST_BIG_ENDIAN)
+	{
+		tr_swap16_buffer(readbuffer, readCount);
+	}
 	pWav->frompcm_func(readbuffer, pBuffer, readCount);
 	free(readbuffer);
 	
@@ -133,11 +183,24 @@ int tr_wavread(tr_wavfile* pWav, float* pBuffer, unsigned int pNumSamples)
 	return 1;
 }
 
+void tr_wavseek(tr_wavfile* pWav, unsigned int pSample)
+{
+	pWav->readpos = pSample;
+}
+
 int tr_wavwrite(tr_wavfile* pWav, float* pBuffer, unsigned int pNumSamples)
 {
+	if(pWav->writebuffer)
+	{
+		return tr_wavwritebuffered(pWav, pBuffer, pNumSamples);
+	}
+	
 	signed short* temp = malloc(pNumSamples * sizeof(signed short));
 	tr_convert_float_pcm16(pBuffer, temp, pNumSamples);
-	fseek(pWav->filehandle, pWav->datastartpos + pWav->totalsamples * sizeof(signed short), SEEK_SET);
+#if TR_HOST_BIG_ENDIAN
+	tr_swap16_buffer(temp, pNumSamples);
+#endif
+	fseek(pWav->filehandle, pWav->datastartpos + (long int)pWav->totalsamples * sizeof(signed short), SEEK_SET);
 	size_t writeCount = fwrite(temp, sizeof(signed short), pNumSamples, pWav->filehandle);
 	free(temp);
 	
@@ -150,17 +213,172 @@ int tr_wavwrite(tr_wavfile* pWav, float* pBuffer, unsigned int pNumSamples)
 	return 1;
 }
 
+int tr_wavwritebuffered(tr_wavfile* pWav, float* pBuffer, unsigned int pNumSamples)
+{
+	int ok = 1;
+	
+	/* Gathered samples have to carry on where the last ones stopped */
+	long int position = pWav->datastartpos + (long int)pWav->totalsamples * sizeof(signed short);
+	if(position != pWav->writeoffset + (long int)pWav->writefill)
+	{
+		ok = tr_wavflush(pWav);
+		pWav->writeoffset = position;
+	}
+	
+	unsigned int done = 0;
+	while(done < pNumSamples)
+	{
+		unsigned int count = (TR_WAV_WRITE_BUFFER - pWav->writefill) / sizeof(signed short);
+		if(count > pNumSamples - done)
+		{
+			count = pNumSamples - done;
+		}
+		
+		signed short* dest = (signed short*)(pWav->writebuffer + pWav->writefill);
+		tr_convert_float_pcm16(pBuffer + done, dest, count);
+#if TR_HOST_BIG_ENDIAN
+		tr_swap16_buffer(dest, count);
+#endif
+		pWav->writefill += count * sizeof(signed short);
+		done += count;
+		
+		if(pWav->writefill == TR_WAV_WRITE_BUFFER && !tr_wavflush(pWav))
+		{
+			ok = 0;
+		}
+	}
+	
+	pWav->totalsamples += pNumSamples;
+	return ok;
+}
+
+int tr_wavreserve(tr_wavfile* pWav, unsigned int pNumSamples, int pDirect)
+{
+	long int length = pWav->datastartpos + (long int)pNumSamples * sizeof(signed short);
+	
+	pWav->writememory = malloc(TR_WAV_WRITE_BUFFER + TR_WAV_ALIGN);
+	if(!pWav->writememory)
+	{
+		return 0;
+	}
+	pWav->writebuffer = pWav->writememory + (TR_WAV_ALIGN - (size_t)pWav->writememory % TR_WAV_ALIGN) % TR_WAV_ALIGN;
+	pWav->reserved    = pNumSamples;
+	pWav->direct      = 0;
+	
+	fflush(pWav->filehandle);
+#ifdef __linux__
+	/* One extent for the whole file where the file system can, nothing is lost where it can not */
+	fallocate(fileno(pWav->filehandle), 0, 0, length);
+#else
+	(void)length;
+#endif
+	
+	tr_wavheader(pWav, pNumSamples, pWav->writebuffer);
+	
+	/* Direct writes start on a block, so the header goes out with the first samples */
+	if(pDirect && pWav->totalsamples == 0)
+	{
+		pWav->writeoffset = 0;
+		pWav->writefill   = pWav->datastartpos;
+		tr_wavsetdirect(pWav, 1);
+		return 1;
+	}
+	
+	pWav->writeoffset = pWav->datastartpos + (long int)pWav->totalsamples * sizeof(signed short);
+	pWav->writefill   = 0;
+	return tr_wavwriteat(pWav, pWav->writebuffer, pWav->datastartpos, 0);
+}
+
+int tr_wavflush(tr_wavfile* pWav)
+{
+	if(!pWav->writebuffer || pWav->writefill == 0)
+	{
+		return 1;
+	}
+	
+	/* The end of the file is rarely a whole block */
+	if(pWav->direct && (pWav->writefill % TR_WAV_ALIGN || pWav->writeoffset % TR_WAV_ALIGN))
+	{
+		tr_wavsetdirect(pWav, 0);
+	}
+	
+	int ok = tr_wavwriteat(pWav, pWav->writebuffer, pWav->writefill, pWav->writeoffset);
+	if(!ok && pWav->direct)
+	{
+		/* Some file systems take the flag and then refuse the writes */
+		tr_wavsetdirect(pWav, 0);
+		ok = tr_wavwriteat(pWav, pWav->writebuffer, pWav->writefill, pWav->writeoffset);
+	}
+	
+	pWav->writeoffset += pWav->writefill;
+	pWav->writefill    = 0;
+	return ok;
+}
+
+int tr_wavwriteat(tr_wavfile* pWav, const void* pData, size_t pCount, long int pOffset)
+{
+#ifdef _WIN32
+	fseek(pWav->filehandle, pOffset, SEEK_SET);
+	return fwrite(pData, 1, pCount, pWav->filehandle) == pCount;
+#else
+	/* Anything stdio still holds goes first, then the write skips its buffer */
+	fflush(pWav->filehandle);
+	
+	const unsigned char* data = pData;
+	while(pCount > 0)
+	{
+		ssize_t written = pwrite(fileno(pWav->filehandle), data, pCount, pOffset);
+		if(written <= 0)
+		{
+			return 0;
+		}
+		data    += written;
+		pCount  -= written;
+		pOffset += written;
+	}
+	return 1;
+#endif
+}
+
+void tr_wavsetdirect(tr_wavfile* pWav, int pDirect)
+{
+	pWav->direct = 0;
+#ifdef O_DIRECT
+	int fd    = fileno(pWav->filehandle);
+	int flags = fcntl(fd, F_GETFL);
+	if(flags != -1 && fcntl(fd, F_SETFL, pDirect ? flags | O_DIRECT : flags & ~O_DIRECT) == 0)
+	{
+		pWav->direct = pDirect;
+	}
+#else
+	(void)pDirect;
+#endif
+}
+
+int tr_wavtruncate(tr_wavfile* pWav, long int pLength)
+{
+	fflush(pWav->filehandle);
+#ifdef _WIN32
+	return _chsize(_fileno(pWav->filehandle), pLength) == 0;
+#else
+	return ftruncate(fileno(pWav->filehandle), pLength) == 0;
+#endif
+}
+
 int tr_iswav(tr_wavfile* pWav)
 {
 	fseek(pWav->filehandle, 0, SEEK_SET);
 	
 	tr_wavfile_riff riff;
-	fread(&riff, sizeof(tr_wavfile_riff), 1, pWav->filehandle);
-	riff.riffID   = BigULong(riff.riffID);
-	riff.filesize = LittleULong(riff.filesize);
-	riff.fmt      = BigULong(riff.fmt);
+	if(fread(&riff, sizeof(tr_wavfile_riff), 1, pWav->filehandle) != 1)
+	{
+		return 0;
+	}
+	riff.riffID   = BigU32(riff.riffID);
+	riff.fmt      = BigU32(riff.fmt);
+	pWav->bigendian = riff.riffID == WAV_RIFX;
 	
-	if( (riff.riffID == WAV_RIFF) && (riff.fmt == WAV_FMT_WAVE) )
+	if( (riff.riffID == WAV_RIFF || riff.riffID == WAV_RIFX) && (riff.fmt == WAV_FMT_WAVE) )
 	{
 		return 1;
 	}
@@ -168,8 +386,9 @@ int tr_iswav(tr_wavfile* pWav)
 	return 0;
 }
 
-int tr_findwavchunk(unsigned int pCnkID, FILE* pFile, long int* pCnkPos)
+int tr_findwavchunk(tr_wavfile* pWav, uint32_t pCnkID, long int* pCnkPos)
 {
+	FILE* pFile = pWav->filehandle;
 	long int originalPos = 0;
 	size_t result        = 0;
 	int found            = 0;
@@ -185,8 +404,8 @@ int tr_findwavchunk(unsigned int pCnkID, FILE* pFile, long int* pCnkPos)
 		fseek(pFile, *pCnkPos, SEEK_SET);
 		
 		result = fread(&cnkStart, 1, sizeof(tr_wavfile_cnkheader), pFile);
-		cnkStart.cnkID    = BigULong(cnkStart.cnkID);
-		cnkStart.cnksize  = LittleULong(cnkStart.cnksize);
+		cnkStart.cnkID    = BigU32(cnkStart.cnkID);
+		cnkStart.cnksize  = WAV_U32(pWav, cnkStart.cnksize);
 		
 		if(result != sizeof(tr_wavfile_cnkheader) ) /* End of file? */
 		{
@@ -201,9 +420,9 @@ int tr_findwavchunk(unsigned int pCnkID, FILE* pFile, long int* pCnkPos)
 		}
 		else
 		{
-			if(cnkStart.cnkID != WAV_RIFF)
+			if(cnkStart.cnkID != WAV_RIFF && cnkStart.cnkID != WAV_RIFX)
 			{
-				*pCnkPos += cnkStart.cnksize + sizeof(tr_wavfile_cnkheader);
+				*pCnkPos += cnkStart.cnksize + (cnkStart.cnksize & 1) + sizeof(tr_wavfile_cnkheader);
 			}
 			else
 			{	/* It's the riff cnk */
@@ -219,16 +438,18 @@ int tr_findwavchunk(unsigned int pCnkID, FILE* pFile, long int* pCnkPos)
 int tr_wavreadfmt(tr_wavfile* pWav)
 {
 	long int chunkpos = 0;
-	if ( tr_findwavchunk(WAV_FMT, pWav->filehandle, &chunkpos) )
+	if ( tr_findwavchunk(pWav, WAV_FMT, &chunkpos) )
 	{
 		fseek(pWav->filehandle, chunkpos, SEEK_SET);
 		tr_wavfile_fmt fmt;
-		fread(&fmt, sizeof(tr_wavfile_fmt), 1, pWav->filehandle);
+		if(fread(&fmt, sizeof(tr_wavfile_fmt), 1, pWav->filehandle) != 1)
+		{
+			return 0;
+		}
 		
-		pWav->channels       = LittleUShort(fmt.numchannels);
-		pWav->samplerate     = LittleULong(fmt.samplerate);
-		pWav->bytespersample = LittleUShort(fmt.bitspersample) /8;
-		pWav->datastartpos   = ftell(pWav->filehandle);
+		pWav->channels       = WAV_U16(pWav, fmt.numchannels);
+		pWav->samplerate     = WAV_U32(pWav, fmt.samplerate);
+		pWav->bytespersample = WAV_U16(pWav, fmt.bitspersample) /8;
 		
 		switch(pWav->bytespersample)
 		{
@@ -246,47 +467,64 @@ int tr_wavreadfmt(tr_wavfile* pWav)
 int tr_wavreaddata(tr_wavfile* pWav)
 {
 	long int chunkpos = 0;
-	if ( tr_findwavchunk(WAV_DATA, pWav->filehandle, &chunkpos) )
+	if ( tr_findwavchunk(pWav, WAV_DATA, &chunkpos) )
 	{
 		fseek(pWav->filehandle, chunkpos, SEEK_SET);
 		tr_wavfile_cnkheader data;
-		fread(&data, sizeof(tr_wavfile_cnkheader), 1, pWav->filehandle);
+		if(fread(&data, sizeof(tr_wavfile_cnkheader), 1, pWav->filehandle) != 1)
+		{
+			return 0;
+		}
 		
-		pWav->totalsamples = data.cnksize / pWav->bytespersample;
+		pWav->totalsamples = WAV_U32(pWav, data.cnksize) / pWav->bytespersample;
+		pWav->datastartpos = chunkpos + sizeof(tr_wavfile_cnkheader);
 		return 1;
 	}
 	return 0;
 }
 
-void tr_wavwriteheaders(tr_wavfile* pWav)
+int tr_wavwriteheaders(tr_wavfile* pWav)
 {
-	fseek(pWav->filehandle, 0, SEEK_END);
-	unsigned long fileSize = ftell(pWav->filehandle);
-	if(fileSize % 2) fileSize += 1;
+	unsigned char header[sizeof(tr_wavfile_riff) + sizeof(tr_wavfile_fmt) + sizeof(tr_wavfile_cnkheader)];
+	tr_wavheader(pWav, pWav->totalsamples, header);
+	int ok = tr_wavwriteat(pWav, header, sizeof(header), 0);
 	
-	fseek(pWav->filehandle, 0, SEEK_SET);
+	/* A file reopened to carry on writing may hold samples past the ones counted */
+	tr_wavtruncate(pWav, pWav->datastartpos + (long int)pWav->totalsamples * sizeof(signed short));
+	return ok;
+}
 
+/**
+	The three headers of a 16 bit PCM wav of pNumSamples.  Sizes come from the samples,
+	not the length of the file, so they can be written before the data.
+*/
+void tr_wavheader(const tr_wavfile* pWav, unsigned int pNumSamples, unsigned char* pDest)
+{
+	uint32_t dataSize = pNumSamples * sizeof(signed short);
+	
 	tr_wavfile_riff riff;
-	riff.riffID = BigULong(WAV_RIFF);
-	riff.filesize = LittleULong(fileSize);
-	riff.fmt = BigULong(WAV_FMT_WAVE);
-	fwrite(&riff, 1, sizeof(tr_wavfile_riff), pWav->filehandle);
+	riff.riffID = BigU32(WAV_RIFF);
+	riff.filesize = LittleU32(pWav->datastartpos - 8 + dataSize + dataSize % 2);
+	riff.fmt = BigU32(WAV_FMT_WAVE);
+	memcpy(pDest, &riff, sizeof(tr_wavfile_riff));
+	pDest += sizeof(tr_wavfile_riff);
 
 	tr_wavfile_fmt fmt;
-	fmt.fmtID         = BigULong(WAV_FMT);
-	fmt.chunksize     = LittleULong(sizeof(tr_wavfile_fmt)- sizeof(tr_wavfile_cnkheader));
-	fmt.format        = LittleULong(WAV_PCM);
-	fmt.numchannels   = LittleULong(pWav->channels);
-	fmt.samplerate    = LittleULong(pWav->samplerate);
-	fmt.byterate      = LittleULong(pWav->samplerate * pWav->channels * WAV_PCMCNK_SIZE/8);
-	fmt.blockalign    = LittleULong(pWav->channels * WAV_PCMCNK_SIZE/8);
-	fmt.bitspersample = LittleULong(WAV_PCMCNK_SIZE);
-	fwrite(&fmt, 1, sizeof(tr_wavfile_fmt), pWav->filehandle);
+	fmt.fmtID         = BigU32(WAV_FMT);
+	fmt.chunksize     = LittleU32(sizeof(tr_wavfile_fmt)- sizeof(tr_wavfile_cnkheader));
+	fmt.format        = LittleU16(WAV_PCM);
+	fmt.numchannels   = LittleU16(pWav->channels);
+	fmt.samplerate    = LittleU32(pWav->samplerate);
+	fmt.byterate      = LittleU32(pWav->samplerate * pWav->channels * WAV_PCMCNK_SIZE/8);
+	fmt.blockalign    = LittleU16(pWav->channels * WAV_PCMCNK_SIZE/8);
+	fmt.bitspersample = LittleU16(WAV_PCMCNK_SIZE);
+	memcpy(pDest, &fmt, sizeof(tr_wavfile_fmt));
+	pDest += sizeof(tr_wavfile_fmt);
 
 	tr_wavfile_cnkheader data;
-	data.cnkID    = BigULong(WAV_DATA);
-	data.cnksize =  LittleULong(fileSize - pWav->datastartpos);
-	fwrite(&data, 1, sizeof(tr_wavfile_cnkheader), pWav->filehandle);
+	data.cnkID    = BigU32(WAV_DATA);
+	data.cnksize =  LittleU32(dataSize);
+	memcpy(pDest, &data, sizeof(tr_wavfile_cnkheader));
 }
 
 
@@ -323,35 +561,41 @@ void tr_convert_pcm16_float(signed short int* pPCMData, float* pOutput, unsigned
 	}
 }
 
+/* Saturates instead of wrapping when a gained sample lands past full scale */
+static inline signed short int tr_float_pcm16(float pSample)
+{
+	double scaled = pSample * 32767.0;
+	return scaled >= 32767.0 ? 32767 : scaled <= -32768.0 ? -32768 : (signed short int)scaled;
+}
+
 void tr_convert_float_pcm16(float* pFloatData, signed short int* pOutput, unsigned int pNumSamples)
 {
-	const double gain      = 32767.0;
 	unsigned int remainder = pNumSamples % 8;
 	pNumSamples -= remainder;
 	
 	while(pNumSamples > 0)
 	{
-		*pOutput++ = (*pFloatData++) * gain;
-		*pOutput++ = (*pFloatData++) * gain;
-		*pOutput++ = (*pFloatData++) * gain;
-		*pOutput++ = (*pFloatData++) * gain;
-		*pOutput++ = (*pFloatData++) * gain;
-		*pOutput++ = (*pFloatData++) * gain;
-		*pOutput++ = (*pFloatData++) * gain;
-		*pOutput++ = (*pFloatData++) * gain;
+		*pOutput++ = tr_float_pcm16(*pFloatData++);
+		*pOutput++ = tr_float_pcm16(*pFloatData++);
+		*pOutput++ = tr_float_pcm16(*pFloatData++);
+		*pOutput++ = tr_float_pcm16(*pFloatData++);
+		*pOutput++ = tr_float_pcm16(*pFloatData++);
+		*pOutput++ = tr_float_pcm16(*pFloatData++);
+		*pOutput++ = tr_float_pcm16(*pFloatData++);
+		*pOutput++ = tr_float_pcm16(*pFloatData++);
 
 		pNumSamples -= 8;
 	}
 	
 	switch(remainder)
 	{
-		case 7:  *pOutput++ = (*pFloatData++) * gain;
-		case 6:  *pOutput++ = (*pFloatData++) * gain;
-		case 5:  *pOutput++ = (*pFloatData++) * gain;
-		case 4:  *pOutput++ = (*pFloatData++) * gain;
-		case 3:  *pOutput++ = (*pFloatData++) * gain;
-		case 2:  *pOutput++ = (*pFloatData++) * gain;
-		case 1:  *pOutput++ = (*pFloatData++) * gain;
+		case 7:  *pOutput++ = tr_float_pcm16(*pFloatData++);
+		case 6:  *pOutput++ = tr_float_pcm16(*pFloatData++);
+		case 5:  *pOutput++ = tr_float_pcm16(*pFloatData++);
+		case 4:  *pOutput++ = tr_float_pcm16(*pFloatData++);
+		case 3:  *pOutput++ = tr_float_pcm16(*pFloatData++);
+		case 2:  *pOutput++ = tr_float_pcm16(*pFloatData++);
+		case 1:  *pOutput++ = tr_float_pcm16(*pFloatData++);
 	}
 }
 
@@ -0,0 +1,122 @@
+#!/bin/sh
+#
+# Renders generated test signals through each mode and compares the outputs with
+# the direct engine, which convolves sample by sample and is the reference.
+#
+#   tests/compare.sh [path/to/trillian]
+#
+# Needs python3, nothing beyond its standard library.  The signals come from fixed
+# seeds so every run renders the same files.  Set KEEP=1 to keep the work directory.
+
+TRILLIAN=${1:-./trillian}
+TOOL="python3 $(cd "$(dirname "$0")" && pwd)/wavtool.py"
+
+case $TRILLIAN in
+	/*) ;;
+	*) TRILLIAN=$(pwd)/$TRILLIAN ;;
+esac
+if [ ! -x "$TRILLIAN" ]; then
+	echo "No trillian executable at $TRILLIAN, build it first or pass its path"
+	exit 1
+fi
+
+WORK=$(mktemp -d) || exit 1
+if [ -z "$KEEP" ]; then
+	trap 'rm -rf "$WORK"' EXIT
+else
+	echo "Work directory $WORK"
+fi
+cd "$WORK" || exit 1
+
+FAILED=0
+fail()
+{
+	echo "FAIL $1"
+	FAILED=$((FAILED + 1))
+}
+
+# run NAME ARGS... renders quietly, the log is kept in NAME.log
+run()
+{
+	name=$1
+	shift
+	"$TRILLIAN" "$@" > "$name.log" 2>&1 || { fail "$name: trillian $*"; cat "$name.log"; return 1; }
+}
+
+# check NAME OUTPUT REFERENCE MAXLSB [MINSNR]
+check()
+{
+	$TOOL compare "$2" "$3" "$4" $5 || fail "$1"
+}
+
+echo "Generating signals"
+$TOOL input in.wav 2 2 1 \
+   && $TOOL response ir.wav 0.4 2 2 \
+   && $TOOL sparse sparse.wav 0.4 2 3 \
+   && $TOOL edit edit.wav in.wav 0.8 1.0 4 \
+   && $TOOL input in6.wav 1 6 5 \
+   && $TOOL response ir6.wav 0.2 6 6 \
+   && $TOOL response short.wav 0.1 2 7 \
+   || exit 1
+
+echo "Rendering references with the direct engine"
+run direct -e direct -o direct.wav in.wav ir.wav \
+   && run direct_sparse -e direct -o direct_sparse.wav in.wav sparse.wav \
+   && run direct_edit -e direct -o direct_edit.wav edit.wav ir.wav \
+   && run direct6 -e direct -o direct6.wav in6.wav ir6.wav \
+   && run direct_short -e direct -o direct_short.wav in.wav short.wav \
+   || exit 1
+
+echo "multirate"
+# The default --multirate allows -50dB of error in the late tail
+if run multirate --multirate -o multirate.wav in.wav ir.wav; then
+	grep -q "rate, error" multirate.log || fail "multirate: no tail was decimated"
+	check multirate multirate.wav direct.wav 16 50
+fi
+
+echo "sparse"
+if run sparse -e sparse -o sparse_out.wav in.wav sparse.wav; then
+	grep -q "no sparse early part" sparse.log && fail "sparse: the early part was not split off"
+	check sparse sparse_out.wav direct_sparse.wav 2
+fi
+
+echo "batch"
+if run batch -e fft -o batch.wav in6.wav ir6.wav; then
+	grep -q batched batch.log || fail "batch: the channels were not batched"
+	check batch batch.wav direct6.wav 2
+fi
+
+echo "shard merge"
+if run shard1 --shard=1/3 -o shard.wav in.wav ir.wav \
+   && run shard2 --shard=2/3 -o shard.wav in.wav ir.wav \
+   && run shard3 --shard=3/3 -o shard.wav in.wav ir.wav \
+   && run merge --merge -o shard.wav; then
+	check merge shard.wav direct.wav 2
+fi
+
+echo "update"
+if run update_first -e fft -o update.wav in.wav ir.wav \
+   && run update --update=update.wav --original=in.wav edit.wav ir.wav; then
+	grep -q "rendering in full" update.log && fail "update: the output was rendered in full"
+	check update update.wav direct_edit.wav 2
+fi
+
+echo "resume"
+# The file size limit stops the render once the partial output outgrows it, after
+# checkpoints have been saved, the same way on every run.  A short response keeps
+# the checkpoints well below the limit.
+LIMIT=$(( $(wc -c < direct_short.wav) * 3 / 4 / 1024 ))
+{ sh -c 'ulimit -f $0; exec "$@"' $LIMIT "$TRILLIAN" -e fft --checkpoint=resume.wav.checkpoint \
+   --checkpoint-interval=0 -o resume.wav in.wav short.wav > resume_first.log 2>&1; } 2> /dev/null
+if [ ! -f resume.wav.checkpoint ]; then
+	fail "resume: the render was not interrupted with a checkpoint"
+elif run resume --checkpoint=resume.wav.checkpoint --resume -o resume.wav in.wav short.wav; then
+	grep -q Resuming resume.log || fail "resume: the render started over"
+	check resume resume.wav direct_short.wav 2
+fi
+
+if [ $FAILED -ne 0 ]; then
+	echo "$FAILED comparisons failed"
+	exit 1
+fi
+echo "All comparisons passed"
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""
+Test signals and output comparison for compare.sh, standard library only.
+
+    wavtool.py input FILE SECONDS CHANNELS SEED
+        decaying noise, the input of a render
+    wavtool.py response FILE SECONDS CHANNELS SEED
+        a direct sound and an exponentially decaying noise tail, low passed past
+        the first 80ms
+    wavtool.py sparse FILE SECONDS CHANNELS SEED
+        a few discrete early reflections ahead of a dense tail
+    wavtool.py edit FILE ORIGINAL START END SEED
+        ORIGINAL with the seconds START to END replaced by other noise
+    wavtool.py compare FILE REFERENCE MAXLSB [MINSNR]
+        fails when FILE and REFERENCE differ in length or channels, any sample
+        differs by more than MAXLSB 16-bit steps, or the signal to error ratio
+        is below MINSNR dB
+"""
+
+import math
+import random
+import struct
+import sys
+
+RATE = 44100
+
+
+def write(path, frames, channels):
+	data = bytearray()
+	for frame in frames:
+		for sample in frame:
+			data += struct.pack("<h", max(-32768, min(32767, int(round(sample * 32767.0)))))
+	header = b"RIFF" + struct.pack("<I", 36 + len(data)) + b"WAVE"
+	header += b"fmt " + struct.pack("<IHHIIHH", 16, 1, channels, RATE, RATE * channels * 2, channels * 2, 16)
+	header += b"data" + struct.pack("<I", len(data))
+	with open(path, "wb") as out:
+		out.write(header + bytes(data))
+
+
+def read(path):
+	with open(path, "rb") as wav:
+		data = wav.read()
+	if data[:4] != b"RIFF" or data[8:12] != b"WAVE":
+		sys.exit("%s: not a RIFF wav file" % path)
+	pos = 12
+	channels = bits = None
+	while pos + 8 <= len(data):
+		chunk, size = data[pos:pos + 4], struct.unpack("<I", data[pos + 4:pos + 8])[0]
+		if chunk == b"fmt ":
+			_, channels, _, _, _, bits = struct.unpack("<HHIIHH", data[pos + 8:pos + 24])
+		elif chunk == b"data":
+			if bits != 16:
+				sys.exit("%s: only 16-bit wav files are compared" % path)
+			count = size // 2
+			samples = struct.unpack("<%dh" % count, data[pos + 8:pos + 8 + count * 2])
+			return channels, samples
+		pos += 8 + size + (size & 1)
+	sys.exit("%s: no data chunk" % path)
+
+
+def noise(rng, count, channels, decay):
+	return [[rng.uniform(-0.5, 0.5) * math.exp(-decay * i / RATE) for c in range(channels)] for i in range(count)]
+
+
+def lowpass(frames, channels, cutoff):
+	"""Blackman windowed sinc, cutoff a fraction of the sample rate, same length out"""
+	taps = 63
+	kernel = []
+	for k in range(taps):
+		t = k - (taps - 1) / 2.0
+		sinc = 2.0 * cutoff * (math.sin(2.0 * math.pi * cutoff * t) / (2.0 * math.pi * cutoff * t) if t else 1.0)
+		kernel.append(sinc * (0.42 - 0.5 * math.cos(2.0 * math.pi * k / (taps - 1)) + 0.08 * math.cos(4.0 * math.pi * k / (taps - 1))))
+	out = []
+	for i in range(len(frames)):
+		window = frames[max(0, i - taps + 1):i + 1]
+		out.append([sum(w * frame[c] for w, frame in zip(kernel[len(window) - 1::-1], window)) for c in range(channels)])
+	return out
+
+
+def main(args):
+	if len(args) == 5 and args[0] in ("input", "response", "sparse"):
+		kind, path, seconds, channels, seed = args[0], args[1], float(args[2]), int(args[3]), int(args[4])
+		rng = random.Random(seed)
+		count = int(seconds * RATE)
+		if kind == "input":
+			frames = noise(rng, count, channels, 0.7)
+		elif kind == "response":
+			# Past the early part highs die away, as in a room, which --multirate relies on
+			frames = noise(rng, count, channels, 16.0)
+			early = int(0.08 * RATE)
+			frames[early:] = lowpass(frames[early:], channels, 0.1)
+			frames[0] = [0.9] * channels
+		else:
+			early = int(0.1 * RATE)
+			frames = [[0.0] * channels for i in range(count)]
+			for i in range(24):
+				frames[rng.randrange(early)] = [rng.uniform(-0.5, 0.5)] * channels
+			frames[0] = [0.9] * channels
+			tail = noise(rng, count - early, channels, 12.0)
+			for i, frame in enumerate(tail):
+				frames[early + i] = [0.2 * sample for sample in frame]
+		write(path, frames, channels)
+	elif len(args) == 6 and args[0] == "edit":
+		path, original, start, end, seed = args[1], args[2], float(args[3]), float(args[4]), int(args[5])
+		channels, samples = read(original)
+		rng = random.Random(seed)
+		frames = [[samples[i + c] / 32767.0 for c in range(channels)] for i in range(0, len(samples), channels)]
+		for i in range(int(start * RATE), min(int(end * RATE), len(frames))):
+			frames[i] = [rng.uniform(-0.2, 0.2) for c in range(channels)]
+		write(path, frames, channels)
+	elif len(args) in (4, 5) and args[0] == "compare":
+		path, reference, maxlsb = args[1], args[2], int(args[3])
+		minsnr = float(args[4]) if len(args) == 5 else None
+		channels, samples = read(path)
+		refchannels, refsamples = read(reference)
+		if channels != refchannels or len(samples) != len(refsamples):
+			print("%s: %u channels, %u samples, the reference has %u channels, %u samples"
+			      % (path, channels, len(samples), refchannels, len(refsamples)))
+			return 1
+		worst = max(abs(a - b) for a, b in zip(samples, refsamples))
+		error = sum((a - b) * (a - b) for a, b in zip(samples, refsamples))
+		signal = sum(b * b for b in refsamples)
+		snr = 10.0 * math.log10(signal / error) if error else float("inf")
+		print("%s: max difference %d lsb, signal to error %.1f dB" % (path, worst, snr))
+		if worst > maxlsb or (minsnr is not None and snr < minsnr):
+			return 1
+	else:
+		sys.exit(__doc__)
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv[1:]))